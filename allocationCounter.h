@@ -0,0 +1,9 @@
+#ifndef allocationCounter_header
+#define allocationCounter_header
+
+#include <cstddef>
+
+//Number of calls to the global operator new since the program started
+size_t allocationCount();
+
+#endif
@@ -0,0 +1,192 @@
+#ifndef assetPack_header
+#define assetPack_header
+
+#include <string>
+#include <memory>
+#include <streambuf>
+#include <cstring>
+#include <cstdint>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "mappedFile.h"
+
+//Asset pack layout: AssetPackHeader, entryCount AssetPackEntry records sorted by name, the name bytes,
+//then every file's bytes starting on an ASSET_PACK_ALIGNMENT boundary. Names are paths relative to the
+//project root with forward slashes, e.g. "resources/textures/wall.jpg".
+struct AssetPackHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t namesSize;
+};
+
+struct AssetPackEntry
+{
+    uint64_t offset;   //From the start of the pack
+    uint64_t size;
+    uint64_t hash;     //hashBytes of the file, matches the source hash stored in cooked assets
+    uint32_t nameOffset;
+    uint32_t nameLength;
+};
+
+const char ASSET_PACK_MAGIC[4] = { 'P', 'A', 'C', 'K' };
+const uint32_t ASSET_PACK_VERSION = 1;
+const uint64_t ASSET_PACK_ALIGNMENT = 4096; //Page aligned, so every blob can be handed out straight from the mapping
+
+/// <summary>
+/// Name of an asset inside the pack. Loaders use paths relative to the binary ("../../../levels/level0")
+/// or prefixed with the project root, so everything up to the last "../" is dropped.
+/// </summary>
+/// <param name="path">Path as used by a loader</param>
+/// <returns>Pack name</returns>
+inline std::string assetName(const std::string& path) {
+    std::string name = path;
+    for (char& c : name) {
+        if (c == '\\') c = '/';
+    }
+    size_t parent = name.rfind("../");
+    if (parent != std::string::npos) name = name.substr(parent + 3);
+    while (name.compare(0, 2, "./") == 0) name = name.substr(2);
+    return name;
+}
+
+//Read-only archive of every asset, mapped once and handed out as views into the mapping
+class AssetPack {
+private:
+    std::unique_ptr<MappedFile> file;
+    const AssetPackEntry* entries = nullptr;
+    const char* names = nullptr;
+    uint32_t entryCount = 0;
+
+    std::string nameOf(const AssetPackEntry& entry) const {
+        return std::string(names + entry.nameOffset, entry.nameLength);
+    }
+public:
+    /// <summary>
+    /// Maps a pack and checks its table of contents. Without a valid pack every lookup misses and loaders use loose files.
+    /// </summary>
+    /// <param name="path">Pack file</param>
+    /// <returns>true if the pack is usable</returns>
+    bool open(const std::string& path) {
+        file.reset(new MappedFile(path));
+        entries = nullptr;
+        entryCount = 0;
+        if (!file->isOpen() || file->size() < sizeof(AssetPackHeader)) return false;
+
+        const AssetPackHeader* header = (const AssetPackHeader*)file->data();
+        if (memcmp(header->magic, ASSET_PACK_MAGIC, 4) != 0 || header->version != ASSET_PACK_VERSION) return false;
+        size_t tableSize = sizeof(AssetPackHeader) + sizeof(AssetPackEntry) * (size_t)header->entryCount + header->namesSize;
+        if (file->size() < tableSize) return false;
+
+        const AssetPackEntry* table = (const AssetPackEntry*)(file->data() + sizeof(AssetPackHeader));
+        for (uint32_t i = 0; i < header->entryCount; i++) {
+            if (table[i].offset + table[i].size > file->size()) return false;
+            if ((uint64_t)table[i].nameOffset + table[i].nameLength > header->namesSize) return false;
+        }
+
+        entries = table;
+        names = (const char*)(table + header->entryCount);
+        entryCount = header->entryCount;
+        return true;
+    }
+
+    bool isOpen() const { return entries != nullptr; }
+    uint32_t size() const { return entryCount; }
+
+    /// <summary>
+    /// Binary search of the table of contents
+    /// </summary>
+    /// <param name="path">Path as used by a loader, see assetName</param>
+    /// <returns>Entry of the asset, nullptr if the pack does not have it</returns>
+    const AssetPackEntry* find(const std::string& path) const {
+        if (!isOpen()) return nullptr;
+        std::string name = assetName(path);
+        uint32_t first = 0, last = entryCount;
+        while (first < last) {
+            uint32_t middle = (first + last) / 2;
+            int order = nameOf(entries[middle]).compare(name);
+            if (order == 0) return &entries[middle];
+            if (order < 0) first = middle + 1;
+            else last = middle;
+        }
+        return nullptr;
+    }
+
+    const unsigned char* data(const AssetPackEntry* entry) const {
+        return file->data() + entry->offset;
+    }
+};
+
+//The game's asset pack, opened at startup
+extern AssetPack assets;
+
+//Bytes of one asset: a view into the asset pack if it has it, otherwise a mapping of the loose file
+class Asset {
+private:
+    const unsigned char* bytes = nullptr;
+    size_t length = 0;
+    const AssetPackEntry* entry = nullptr;
+    std::unique_ptr<MappedFile> loose;
+public:
+    /// <summary>
+    /// Looks an asset up in the pack, falling back to the file system
+    /// </summary>
+    /// <param name="path">Path of the loose file, its pack name is derived from it</param>
+    explicit Asset(const std::string& path) {
+        entry = assets.find(path);
+        if (entry) {
+            bytes = assets.data(entry);
+            length = entry->size;
+            return;
+        }
+        loose.reset(new MappedFile(path));
+        bytes = loose->data();
+        length = loose->size();
+    }
+
+    bool isOpen() const { return bytes != nullptr; }
+    bool packed() const { return entry != nullptr; }
+    const unsigned char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+    /// <summary>
+    /// Content hash, taken from the pack's table of contents when possible
+    /// </summary>
+    /// <returns>hashBytes of the asset, 0 if it could not be read</returns>
+    uint64_t hash() const {
+        if (entry) return entry->hash;
+        return isOpen() ? hashBytes(bytes, length) : 0;
+    }
+};
+
+//Lets stream based parsers read an asset in place
+class AssetStreamBuffer : public std::streambuf {
+public:
+    AssetStreamBuffer(const Asset& asset) {
+        char* begin = (char*)asset.data();
+        setg(begin, begin, begin + asset.size());
+    }
+};
+
+/// <summary>
+/// Tells if the source a cooked asset was made from is unchanged.
+/// Sources in the pack are compared by hash. Loose sources by size and modification time, hashing them only when the time differs.
+/// </summary>
+/// <param name="sourcePath">Source file</param>
+/// <param name="sourceSize">Size recorded when cooking</param>
+/// <param name="sourceTime">Modification time recorded when cooking</param>
+/// <param name="sourceHash">Hash recorded when cooking</param>
+/// <returns>true if the cooked asset can be used</returns>
+inline bool sourceUnchanged(const std::string& sourcePath, uint64_t sourceSize, int64_t sourceTime, uint64_t sourceHash) {
+    const AssetPackEntry* entry = assets.find(sourcePath);
+    if (entry) return entry->size == sourceSize && entry->hash == sourceHash;
+
+    struct stat source;
+    if (stat(sourcePath.c_str(), &source) != 0) return true; //No source to compare with, trust the cooked copy
+    if ((uint64_t)source.st_size != sourceSize) return false;
+    if ((int64_t)source.st_mtime == sourceTime) return true;
+    return hashFile(sourcePath) == sourceHash;
+}
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef cookedTexture_header
+#define cookedTexture_header
+
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include "mappedFile.h"
+#include "assetPack.h"
+
+//Container written by the TextureCooker tool next to a source image as <image>.ptex:
+//a header, a table of mip levels, then the pixel data of each level at its offset.
+
+enum CookedTextureFormat : uint32_t
+{
+	COOKED_RGBA8 = 0, //Uncompressed, 4 bytes per texel
+	COOKED_BC1 = 1    //S3TC DXT1, 8 bytes per 4x4 block
+};
+
+struct CookedTextureHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t levelCount;
+	uint64_t sourceHash;
+	int64_t sourceTime;
+	uint64_t sourceSize;
+};
+
+struct CookedTextureLevel
+{
+	uint32_t width;
+	uint32_t height;
+	uint64_t offset; //From the start of the file
+	uint64_t size;
+};
+
+const char COOKED_TEXTURE_MAGIC[4] = { 'P', 'T', 'E', 'X' };
+const uint32_t COOKED_TEXTURE_VERSION = 1;
+const uint32_t COOKED_TEXTURE_ALIGNMENT = 16; //Level data offsets are multiples of this
+
+/// <summary>
+/// Byte size of one mip level in a format
+/// </summary>
+/// <param name="format">Cooked texture format</param>
+/// <param name="width">Level width</param>
+/// <param name="height">Level height</param>
+/// <returns>Size in bytes</returns>
+inline uint64_t cookedLevelSize(uint32_t format, uint32_t width, uint32_t height) {
+	if (format == COOKED_BC1) return (uint64_t)((width + 3) / 4) * ((height + 3) / 4) * 8;
+	return (uint64_t)width * height * 4;
+}
+
+/// <summary>
+/// Bilinear resize of an RGBA8 image. Used to bring images to a common size so they can share a texture array.
+/// </summary>
+/// <param name="source">Source pixels</param>
+/// <param name="sourceWidth">Source width</param>
+/// <param name="sourceHeight">Source height</param>
+/// <param name="target">Target pixels, targetWidth * targetHeight * 4 bytes</param>
+/// <param name="targetWidth">Target width</param>
+/// <param name="targetHeight">Target height</param>
+inline void resampleRGBA8(const unsigned char* source, int sourceWidth, int sourceHeight, unsigned char* target, int targetWidth, int targetHeight) {
+	for (int y = 0; y < targetHeight; y++) {
+		float sy = ((y + 0.5f) * sourceHeight / targetHeight) - 0.5f;
+		int y0 = sy < 0 ? 0 : (int)sy;
+		int y1 = y0 + 1 < sourceHeight ? y0 + 1 : sourceHeight - 1;
+		float fy = sy < 0 ? 0 : sy - y0;
+		for (int x = 0; x < targetWidth; x++) {
+			float sx = ((x + 0.5f) * sourceWidth / targetWidth) - 0.5f;
+			int x0 = sx < 0 ? 0 : (int)sx;
+			int x1 = x0 + 1 < sourceWidth ? x0 + 1 : sourceWidth - 1;
+			float fx = sx < 0 ? 0 : sx - x0;
+			for (int c = 0; c < 4; c++) {
+				float top = source[((size_t)y0 * sourceWidth + x0) * 4 + c] * (1 - fx) + source[((size_t)y0 * sourceWidth + x1) * 4 + c] * fx;
+				float bottom = source[((size_t)y1 * sourceWidth + x0) * 4 + c] * (1 - fx) + source[((size_t)y1 * sourceWidth + x1) * 4 + c] * fx;
+				target[((size_t)y * targetWidth + x) * 4 + c] = (unsigned char)(top * (1 - fy) + bottom * fy + 0.5f);
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Mip level table following the header
+/// </summary>
+inline const CookedTextureLevel* cookedTextureLevels(const CookedTextureHeader* header) {
+	return (const CookedTextureLevel*)(header + 1);
+}
+
+/// <summary>
+/// Checks a cooked texture for consistency and against the image it was cooked from, see sourceUnchanged
+/// </summary>
+/// <param name="cooked">Cooked texture file</param>
+/// <param name="sourcePath">Image it was cooked from</param>
+/// <returns>Header of the cooked texture, or nullptr if it is missing, corrupt or stale</returns>
+inline const CookedTextureHeader* cookedTextureHeader(const Asset& cooked, const std::string& sourcePath) {
+	if (!cooked.isOpen() || cooked.size() < sizeof(CookedTextureHeader)) return nullptr;
+
+	const CookedTextureHeader* header = (const CookedTextureHeader*)cooked.data();
+	if (memcmp(header->magic, COOKED_TEXTURE_MAGIC, 4) != 0 || header->version != COOKED_TEXTURE_VERSION) return nullptr;
+	if (header->format > COOKED_BC1 || header->levelCount == 0) return nullptr;
+	if (cooked.size() < sizeof(CookedTextureHeader) + sizeof(CookedTextureLevel) * (uint64_t)header->levelCount) return nullptr;
+
+	const CookedTextureLevel* levels = cookedTextureLevels(header);
+	for (uint32_t i = 0; i < header->levelCount; i++) {
+		if (levels[i].size != cookedLevelSize(header->format, levels[i].width, levels[i].height)) return nullptr;
+		if (levels[i].offset + levels[i].size > cooked.size()) return nullptr;
+	}
+
+	return sourceUnchanged(sourcePath, header->sourceSize, header->sourceTime, header->sourceHash) ? header : nullptr;
+}
+
+#endif
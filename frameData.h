@@ -0,0 +1,47 @@
+#ifndef frameData_header
+#define frameData_header
+
+#include <glad/glad.h>
+#include "glm/glm/glm.hpp"
+#include "learnopengl/shader_m.h"
+
+//Per-frame constants, mirrors the std140 FrameData uniform block in the shaders.
+//vec3 members are stored as vec4 as std140 pads them to 16 bytes.
+struct FrameData
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec4 cameraPosition;
+	glm::vec4 lightDirection;
+	glm::vec4 lightAmbient;
+	glm::vec4 lightDiffuse;
+	glm::vec4 lightSpecular;
+};
+
+GLuint createFrameBuffer();
+void updateFrameBuffer(GLuint ubo, const FrameData& data);
+
+/// <summary>
+/// Creates the uniform buffer holding FrameData and binds it to the binding point every Shader uses
+/// </summary>
+/// <returns>New uniform buffer</returns>
+GLuint createFrameBuffer() {
+	GLuint ubo;
+	glGenBuffers(1, &ubo);
+	glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), nullptr, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, Shader::FRAME_DATA_BINDING, ubo);
+	return ubo;
+}
+
+/// <summary>
+/// Uploads this frame's constants with a single sub-upload
+/// </summary>
+/// <param name="ubo">Uniform buffer from createFrameBuffer</param>
+/// <param name="data">Frame constants</param>
+void updateFrameBuffer(GLuint ubo, const FrameData& data) {
+	glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &data);
+}
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef frustum_header
+#define frustum_header
+
+#include <vector>
+#include <cstdint>
+#include "glm/glm/glm.hpp"
+
+//SSE is always there on x64 and on x86 builds that ask for it
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FRUSTUM_SIMD 1
+#include <xmmintrin.h>
+#else
+#define FRUSTUM_SIMD 0
+#endif
+
+using namespace std;
+
+//Six planes facing into the view volume, xyz is the unit normal and w the distance term
+struct Frustum
+{
+	glm::vec4 planes[6];
+};
+
+//Axis aligned boxes stored as separate arrays, so four of them can be tested against a plane at once.
+//The arrays are padded to a multiple of four with empty boxes.
+struct BoxSet
+{
+	vector<float> centerX, centerY, centerZ;
+	vector<float> extentX, extentY, extentZ;
+	size_t count = 0;
+
+	void add(glm::vec3 center, glm::vec3 extent) {
+		if (count % 4 == 0) {
+			for (auto array : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ }) {
+				array->resize(count + 4, 0.0f);
+			}
+		}
+		centerX[count] = center.x;
+		centerY[count] = center.y;
+		centerZ[count] = center.z;
+		extentX[count] = extent.x;
+		extentY[count] = extent.y;
+		extentZ[count] = extent.z;
+		count++;
+	}
+};
+
+Frustum extractFrustum(const glm::mat4& viewProjection);
+void cullBoxes(const Frustum& frustum, const BoxSet& boxes, vector<uint8_t>& visible);
+bool sphereVisible(const Frustum& frustum, glm::vec3 center, float radius);
+
+/// <summary>
+/// Pulls the clipping planes out of a view projection matrix
+/// </summary>
+/// <param name="viewProjection">Projection times view</param>
+/// <returns>Normalized frustum planes</returns>
+Frustum extractFrustum(const glm::mat4& viewProjection) {
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++) {
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	}
+
+	Frustum frustum;
+	frustum.planes[0] = rows[3] + rows[0]; //Left
+	frustum.planes[1] = rows[3] - rows[0]; //Right
+	frustum.planes[2] = rows[3] + rows[1]; //Bottom
+	frustum.planes[3] = rows[3] - rows[1]; //Top
+	frustum.planes[4] = rows[3] + rows[2]; //Near
+	frustum.planes[5] = rows[3] - rows[2]; //Far
+	for (auto& plane : frustum.planes) {
+		plane /= glm::length(glm::vec3(plane));
+	}
+	return frustum;
+}
+
+/// <summary>
+/// Tests every box against the frustum. A box is culled when it lies completely behind one of the planes,
+/// found by pushing its extent towards the plane: dot(n, center) + dot(|n|, extent) + w < 0.
+/// Runs four boxes per step with SSE where available.
+/// </summary>
+/// <param name="frustum">View frustum</param>
+/// <param name="boxes">Boxes to test</param>
+/// <param name="visible">Set to 1 for every box that may be visible and 0 otherwise, sized to the box count by the caller</param>
+void cullBoxes(const Frustum& frustum, const BoxSet& boxes, vector<uint8_t>& visible) {
+#if FRUSTUM_SIMD
+	for (size_t i = 0; i < boxes.count; i += 4) {
+		__m128 centerX = _mm_loadu_ps(&boxes.centerX[i]);
+		__m128 centerY = _mm_loadu_ps(&boxes.centerY[i]);
+		__m128 centerZ = _mm_loadu_ps(&boxes.centerZ[i]);
+		__m128 extentX = _mm_loadu_ps(&boxes.extentX[i]);
+		__m128 extentY = _mm_loadu_ps(&boxes.extentY[i]);
+		__m128 extentZ = _mm_loadu_ps(&boxes.extentZ[i]);
+
+		__m128 inside = _mm_cmpeq_ps(centerX, centerX); //All lanes set
+		for (auto& plane : frustum.planes) {
+			__m128 distance = _mm_set1_ps(plane.w);
+			distance = _mm_add_ps(distance, _mm_mul_ps(centerX, _mm_set1_ps(plane.x)));
+			distance = _mm_add_ps(distance, _mm_mul_ps(centerY, _mm_set1_ps(plane.y)));
+			distance = _mm_add_ps(distance, _mm_mul_ps(centerZ, _mm_set1_ps(plane.z)));
+			distance = _mm_add_ps(distance, _mm_mul_ps(extentX, _mm_set1_ps(glm::abs(plane.x))));
+			distance = _mm_add_ps(distance, _mm_mul_ps(extentY, _mm_set1_ps(glm::abs(plane.y))));
+			distance = _mm_add_ps(distance, _mm_mul_ps(extentZ, _mm_set1_ps(glm::abs(plane.z))));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		for (size_t lane = 0; lane < 4 && i + lane < boxes.count; lane++) {
+			visible[i + lane] = (mask >> lane) & 1;
+		}
+	}
+#else
+	for (size_t i = 0; i < boxes.count; i++) {
+		bool inside = true;
+		for (auto& plane : frustum.planes) {
+			float distance = plane.w
+				+ boxes.centerX[i] * plane.x + boxes.centerY[i] * plane.y + boxes.centerZ[i] * plane.z
+				+ boxes.extentX[i] * glm::abs(plane.x) + boxes.extentY[i] * glm::abs(plane.y) + boxes.extentZ[i] * glm::abs(plane.z);
+			inside = inside && distance >= 0.0f;
+		}
+		visible[i] = inside ? 1 : 0;
+	}
+#endif
+}
+
+/// <summary>
+/// Tests a bounding sphere against the frustum
+/// </summary>
+/// <param name="frustum">View frustum</param>
+/// <param name="center">Sphere center</param>
+/// <param name="radius">Sphere radius</param>
+/// <returns>false if the sphere is completely outside</returns>
+bool sphereVisible(const Frustum& frustum, glm::vec3 center, float radius) {
+	for (auto& plane : frustum.planes) {
+		if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) return false;
+	}
+	return true;
+}
+
+#endif
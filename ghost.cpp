@@ -5,14 +5,14 @@ extern bool gameOver;
 /// <summary>
 /// Ghost constructor
 /// </summary>
-/// <param name="_level">Level data</param>
+/// <param name="_level">Level data, shared by all ghosts</param>
 /// <param name="_x">x position</param>
 /// <param name="_y">y position</param>
-Ghost::Ghost(std::vector<std::vector<int>> _level, int _x, int _y)
+Ghost::Ghost(const LevelGrid& _level, int _x, int _y) : level(_level)
 {
 	prevGridPosition = gridPosition = glm::vec3(_x, -0.65, _y);
+	previousPosition = exactPosition = glm::vec3(_y, -0.65, _x);
 	dir = glm::vec2(0, 0);
-	level = _level;
 
 	//generate start direction
 	currentDir = newDirection();
@@ -40,12 +40,8 @@ bool Ghost::checkDir(int dirx, int diry) {
 	int _x = gridPosition.x + dirx;
 	int _y = gridPosition.z + diry;
 
-	bool outOfX = (_x < 0 || _x > level.size() - 1);
-	bool outOfY = (_y < 0 || _y > level[1].size() - 1);
-	bool outOfBounds = (outOfX || outOfY);
-
-	if (!outOfBounds && level[_x][_y] != 1) return true;
-	return false;
+	//Ghost grid x/y are world z/x
+	return level.isWalkable(_y, _x);
 }
 
 /// <summary>
@@ -119,9 +115,10 @@ void Ghost::move() {
 /// <summary>
 /// Either applies movement decided by AI or calls AI to define said movement for next frame
 /// </summary>
-/// <param name="dt"> Time since last frame for consistent speed</param>
+/// <param name="dt"> Length of one simulation tick</param>
 /// <returns>Returns current exact position</returns>
 glm::vec3 Ghost::updateGhost(float dt) {
+	previousPosition = exactPosition;
 	if (transform) {
 		lerp(dt);
 	}
@@ -131,10 +128,19 @@ glm::vec3 Ghost::updateGhost(float dt) {
 	return exactPosition;
 }
 
+/// <summary>
+/// Position to render at, between the previous and the current simulation tick
+/// </summary>
+/// <param name="alpha">How far the renderer is into the next tick, 0 to 1</param>
+/// <returns>Interpolated position</returns>
+glm::vec3 Ghost::getPosition(float alpha) {
+	return glm::mix(previousPosition, exactPosition, alpha);
+}
+
 /// <summary>
 /// Lerp from previous position to new position
 /// </summary>
-/// <param name="dt"> Time since last frame for consistent speed</param>
+/// <param name="dt"> Length of one simulation tick</param>
 void Ghost::lerp(float dt) {
 	linTime += dt*1;
 	if (linTime <= 1) {
@@ -4,15 +4,17 @@
 #include <vector>
 #include <iostream>
 #include "glm/glm/glm.hpp"
+#include "levelGrid.h"
 
 using namespace std;
 
 class Ghost {
 private:
     //Variables
-    std::vector<std::vector<int>> level;
+    const LevelGrid& level;
     glm::vec3 prevGridPosition;
     glm::vec3 exactPosition;
+    glm::vec3 previousPosition; //exactPosition at the start of the current tick
     glm::vec3 gridPosition;
     glm::vec2 dir;
     float linTime = 0;
@@ -26,8 +28,9 @@ private:
     void lerp(float dt);
     void move();
 public:
-    Ghost(std::vector<std::vector<int>> _level, int _x, int _y);
+    Ghost(const LevelGrid& _level, int _x, int _y);
     glm::vec3 updateGhost(float dt);
+    glm::vec3 getPosition(float alpha);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,351 @@
+#ifndef GpuCulling_header
+#define GpuCulling_header
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <glad/glad.h>
+#include "glm/glm/glm.hpp"
+#include "learnopengl/shader_m.h"
+#include "vaoHandler.h"
+#include "frustum.h"
+
+using namespace std;
+
+//Bounding sphere and draw command of one object culled on the GPU, laid out as shaders/cull.comp reads it
+struct CullObject
+{
+	glm::vec4 sphere; //World space center and radius, radius 0 once the object is gone
+	GLint command;    //Command within the batch counting the object, -1 to pick one by level of detail
+	GLint source;     //Instance copied to the culled instance buffer, -1 for objects without instance data
+	GLint padding[2];
+};
+
+//Objects tested by one dispatch and drawn by one run of commands
+struct CullBatch
+{
+	GLuint objects;         //SSBO of CullObject
+	int objectCount;
+	GLuint sourceInstances; //Instance buffer the objects' instance data is copied from, 0 for none
+	GLuint culledInstances; //Instance buffer the VAO draws from, 0 for none
+	int firstCommand;
+	int commandCount;
+};
+
+//GPU driven culling: every object lives in a storage buffer, a compute shader tests them against the view frustum
+//and the previous frame's depth pyramid and fills the indirect draw commands itself. The CPU resets the commands,
+//dispatches once per batch and draws once per batch, however many objects there are.
+class GpuCulling {
+private:
+	//Variables
+	Shader cullShader;
+	Shader hiZShader;
+	vector<CullBatch> batches;
+	vector<DrawElementsIndirectCommand> commandTemplate; //Every command with no instances, copied over the live ones each frame
+	GLuint templateBuffer = 0;
+	GLuint indirectBuffer = 0;
+
+	//Commands of an earlier frame copied aside for reporting, read once their fence has passed so reading never stalls
+	GLuint readbackBuffer = 0;
+	GLsync readbackFence = 0;
+	vector<DrawElementsIndirectCommand> readback;
+
+	//Depth pyramid of the previous frame, built from a copy of its depth buffer
+	GLuint depthCopy = 0;
+	GLuint hiZ = 0;
+	int width = 0;
+	int height = 0;
+	int hiZLevels = 0;
+	glm::mat4 hiZViewProjection;
+	bool hiZValid = false;
+
+	//Uniform locations, resolved once
+	GLint objectCountLocation, firstCommandLocation, planesLocation, useHiZLocation, hiZViewProjectionLocation, cameraPositionLocation;
+	GLint sourceLevelLocation;
+public:
+	GpuCulling(const char* cullPath, const char* hiZPath, int _width, int _height);
+	~GpuCulling();
+	int addBatch(const vector<CullObject>& objects, const vector<DrawElementsIndirectCommand>& commands,
+		GLuint VAO, GLuint sourceInstances, int instanceCapacity);
+	void finishBatches();
+	void setLodSelection(int lodCount, float pixelScale, float fullDetailPixels);
+	void updateSphere(int batch, int index, glm::vec4 sphere);
+	void cull(const Frustum& frustum, glm::vec3 camera);
+	void draw(int batch, GLuint VAO, Shader& shader);
+	void buildHiZ(const glm::mat4& viewProjection);
+	bool readBackCommands();
+	int commandsDrawn(int batch) const;
+	int instancesDrawn(int batch) const;
+};
+
+const int CULL_GROUP_SIZE = 64; // local_size_x of shaders/cull.comp
+const int HIZ_GROUP_SIZE = 8;   // local_size_x and local_size_y of shaders/hiz.comp
+const GLenum HIZ_TEXTURE_UNIT = GL_TEXTURE1; // Unit 0 holds the texture array for the whole run
+
+/// <summary>
+/// Compiles the culling programs and allocates the depth pyramid for a framebuffer size
+/// </summary>
+/// <param name="cullPath">Culling compute shader</param>
+/// <param name="hiZPath">Depth pyramid compute shader</param>
+/// <param name="_width">Framebuffer width in pixels</param>
+/// <param name="_height">Framebuffer height in pixels</param>
+GpuCulling::GpuCulling(const char* cullPath, const char* hiZPath, int _width, int _height)
+	: cullShader(cullPath), hiZShader(hiZPath), width(_width), height(_height) {
+	objectCountLocation = cullShader.uniform("objectCount");
+	firstCommandLocation = cullShader.uniform("firstCommand");
+	planesLocation = cullShader.uniform("planes");
+	useHiZLocation = cullShader.uniform("useHiZ");
+	hiZViewProjectionLocation = cullShader.uniform("hiZViewProjection");
+	cameraPositionLocation = cullShader.uniform("cameraPosition");
+	sourceLevelLocation = hiZShader.uniform("sourceLevel");
+
+	hiZLevels = (int)floor(log2((float)max(width, height))) + 1;
+	cullShader.use();
+	cullShader.setInt("hiZ", HIZ_TEXTURE_UNIT - GL_TEXTURE0);
+	cullShader.setInt("hiZLevels", hiZLevels);
+	hiZShader.use();
+	hiZShader.setInt("source", HIZ_TEXTURE_UNIT - GL_TEXTURE0);
+
+	glActiveTexture(HIZ_TEXTURE_UNIT);
+	glGenTextures(1, &depthCopy);
+	glBindTexture(GL_TEXTURE_2D, depthCopy);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, width, height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	//Every level keeps the farthest depth of the four or so texels below it
+	glGenTextures(1, &hiZ);
+	glBindTexture(GL_TEXTURE_2D, hiZ);
+	glTexStorage2D(GL_TEXTURE_2D, hiZLevels, GL_R32F, width, height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+/// <summary>
+/// Frees every buffer and texture the culling owns. The culled instance buffers are attached to their VAOs and freed with them by cleanVAO.
+/// Needs the context, so destroy it before glfwTerminate.
+/// </summary>
+GpuCulling::~GpuCulling() {
+	for (auto& batch : batches) {
+		glDeleteBuffers(1, &batch.objects);
+		if (batch.sourceInstances) glDeleteBuffers(1, &batch.sourceInstances);
+	}
+	glDeleteBuffers(1, &templateBuffer);
+	glDeleteBuffers(1, &indirectBuffer);
+	glDeleteBuffers(1, &readbackBuffer);
+	if (readbackFence) glDeleteSync(readbackFence);
+	glDeleteTextures(1, &depthCopy);
+	glDeleteTextures(1, &hiZ);
+}
+
+/// <summary>
+/// Adds a set of objects drawn by one VAO. Objects with instance data have it copied from the source buffer into a new
+/// culled instance buffer, which replaces the source as the VAO's instance attributes. The batch takes over the source buffer.
+/// </summary>
+/// <param name="objects">Objects to cull, command relative to the batch's commands</param>
+/// <param name="commands">Draw commands of the batch. baseInstance is the command's range in the culled instance buffer, instanceCount is filled by the GPU.</param>
+/// <param name="VAO">VAO the batch is drawn with</param>
+/// <param name="sourceInstances">Instance buffer the objects' source indices refer to, 0 if they have none</param>
+/// <param name="instanceCapacity">Size of the culled instance buffer, enough for every command's range</param>
+/// <returns>Batch index</returns>
+int GpuCulling::addBatch(const vector<CullObject>& objects, const vector<DrawElementsIndirectCommand>& commands,
+	GLuint VAO, GLuint sourceInstances, int instanceCapacity) {
+	CullBatch batch = {};
+	glGenBuffers(1, &batch.objects);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, batch.objects);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(CullObject) * objects.size(), objects.data(), GL_DYNAMIC_DRAW);
+	batch.objectCount = objects.size();
+
+	if (sourceInstances) {
+		batch.sourceInstances = sourceInstances;
+		glGenBuffers(1, &batch.culledInstances);
+		glBindBuffer(GL_ARRAY_BUFFER, batch.culledInstances);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(Instance) * instanceCapacity, nullptr, GL_DYNAMIC_COPY);
+		attachInstanceBuffer(VAO, batch.culledInstances);
+	}
+
+	batch.firstCommand = commandTemplate.size();
+	batch.commandCount = commands.size();
+	for (auto command : commands) {
+		command.instanceCount = 0;
+		commandTemplate.push_back(command);
+	}
+	batches.push_back(batch);
+	return batches.size() - 1;
+}
+
+/// <summary>
+/// Uploads the commands of every batch added so far, call once after the last addBatch
+/// </summary>
+void GpuCulling::finishBatches() {
+	GLsizeiptr size = sizeof(DrawElementsIndirectCommand) * commandTemplate.size();
+	glGenBuffers(1, &templateBuffer);
+	glBindBuffer(GL_COPY_READ_BUFFER, templateBuffer);
+	glBufferData(GL_COPY_READ_BUFFER, size, commandTemplate.data(), GL_STATIC_COPY);
+	glGenBuffers(1, &indirectBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, indirectBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, size, commandTemplate.data(), GL_DYNAMIC_COPY);
+	glGenBuffers(1, &readbackBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, readbackBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STREAM_READ);
+	readback = commandTemplate;
+}
+
+/// <summary>
+/// Sets how objects without a fixed command pick a level of detail, the same way as selectLod in main.cpp
+/// </summary>
+/// <param name="lodCount">Number of levels, one command per level</param>
+/// <param name="pixelScale">Screen height in pixels over tan(fov / 2)</param>
+/// <param name="fullDetailPixels">Screen height at and above which full detail is drawn, every halving drops a level</param>
+void GpuCulling::setLodSelection(int lodCount, float pixelScale, float fullDetailPixels) {
+	cullShader.use();
+	cullShader.setInt("lodCount", lodCount);
+	cullShader.setFloat("lodPixelScale", pixelScale);
+	cullShader.setFloat("lodFullDetailPixels", fullDetailPixels);
+}
+
+/// <summary>
+/// Moves an object or, with a radius of 0, takes it out of the batch
+/// </summary>
+/// <param name="batch">Batch index</param>
+/// <param name="index">Object within the batch</param>
+/// <param name="sphere">World space center and radius</param>
+void GpuCulling::updateSphere(int batch, int index, glm::vec4 sphere) {
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, batches[batch].objects);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(CullObject) * index + offsetof(CullObject, sphere), sizeof(glm::vec4), &sphere);
+}
+
+/// <summary>
+/// Culls every batch and fills the indirect commands for this frame's draws.
+/// Occlusion is tested against the previous frame's depth, so an object coming out from behind a wall shows up a frame late.
+/// </summary>
+/// <param name="frustum">View frustum</param>
+/// <param name="camera">Camera position, for the level of detail</param>
+void GpuCulling::cull(const Frustum& frustum, glm::vec3 camera) {
+	glBindBuffer(GL_COPY_READ_BUFFER, templateBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, indirectBuffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(DrawElementsIndirectCommand) * commandTemplate.size());
+
+	cullShader.use();
+	glUniform4fv(planesLocation, 6, &frustum.planes[0].x);
+	cullShader.setVec3(cameraPositionLocation, camera);
+	cullShader.setBool(useHiZLocation, hiZValid);
+	if (hiZValid) {
+		cullShader.setMat4(hiZViewProjectionLocation, hiZViewProjection);
+		glActiveTexture(HIZ_TEXTURE_UNIT);
+		glBindTexture(GL_TEXTURE_2D, hiZ);
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, indirectBuffer);
+	for (auto& batch : batches) {
+		if (batch.objectCount == 0) continue;
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, batch.objects);
+		if (batch.sourceInstances) {
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, batch.sourceInstances);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, batch.culledInstances);
+		}
+		cullShader.setInt(objectCountLocation, batch.objectCount);
+		cullShader.setInt(firstCommandLocation, batch.firstCommand);
+		glDispatchCompute((batch.objectCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+	}
+
+	//The draws read the commands and the culled instances the dispatches just wrote, the read-back copies the commands
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	//Keep this frame's commands for readBackCommands, unless an earlier copy is still on its way
+	if (!readbackFence) {
+		glBindBuffer(GL_COPY_READ_BUFFER, indirectBuffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, readbackBuffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(DrawElementsIndirectCommand) * commandTemplate.size());
+		readbackFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+}
+
+/// <summary>
+/// Draws a batch with the commands the last cull filled, in a single call
+/// </summary>
+/// <param name="batch">Batch index</param>
+/// <param name="VAO">VAO to draw</param>
+/// <param name="shader">ShaderProgram variant to draw with</param>
+void GpuCulling::draw(int batch, GLuint VAO, Shader& shader) {
+	const CullBatch& drawn = batches[batch];
+	if (drawn.commandCount == 0) return;
+	shader.use();
+	glBindVertexArray(VAO);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(sizeof(DrawElementsIndirectCommand) * drawn.firstCommand), drawn.commandCount, 0);
+}
+
+/// <summary>
+/// Builds the depth pyramid the next frame's occlusion test reads, from the depth buffer of the frame just drawn
+/// </summary>
+/// <param name="viewProjection">View and projection the frame was drawn with</param>
+void GpuCulling::buildHiZ(const glm::mat4& viewProjection) {
+	glActiveTexture(HIZ_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, depthCopy);
+	glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height);
+
+	//Level 0 from the copy, every further level from the one below it
+	hiZShader.use();
+	for (int level = 0; level < hiZLevels; level++) {
+		int levelWidth = max(width >> level, 1), levelHeight = max(height >> level, 1);
+		glBindTexture(GL_TEXTURE_2D, level == 0 ? depthCopy : hiZ);
+		hiZShader.setInt(sourceLevelLocation, max(level - 1, 0));
+		glBindImageTexture(0, hiZ, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		glDispatchCompute((levelWidth + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE, (levelHeight + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	}
+	glActiveTexture(GL_TEXTURE0);
+
+	hiZViewProjection = viewProjection;
+	hiZValid = true;
+}
+
+/// <summary>
+/// Fetches the commands of the last culled frame whose copy the GPU has finished, without waiting for it.
+/// commandsDrawn and instancesDrawn report them until the next successful call.
+/// </summary>
+/// <returns>true if newer commands were read</returns>
+bool GpuCulling::readBackCommands() {
+	if (!readbackFence) return false;
+	GLenum status = glClientWaitSync(readbackFence, 0, 0);
+	if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return false;
+	glDeleteSync(readbackFence);
+	readbackFence = 0;
+
+	glBindBuffer(GL_COPY_READ_BUFFER, readbackBuffer);
+	glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(DrawElementsIndirectCommand) * readback.size(), readback.data());
+	return true;
+}
+
+/// <summary>
+/// Commands of a batch that drew anything in the read-back frame
+/// </summary>
+/// <param name="batch">Batch index</param>
+/// <returns>Number of commands with instances</returns>
+int GpuCulling::commandsDrawn(int batch) const {
+	const CullBatch& counted = batches[batch];
+	int drawn = 0;
+	for (int i = counted.firstCommand; i < counted.firstCommand + counted.commandCount; i++) {
+		if (readback[i].instanceCount > 0) drawn++;
+	}
+	return drawn;
+}
+
+/// <summary>
+/// Objects of a batch that passed culling in the read-back frame
+/// </summary>
+/// <param name="batch">Batch index</param>
+/// <returns>Number of instances over all of the batch's commands</returns>
+int GpuCulling::instancesDrawn(int batch) const {
+	const CullBatch& counted = batches[batch];
+	int drawn = 0;
+	for (int i = counted.firstCommand; i < counted.firstCommand + counted.commandCount; i++) {
+		drawn += readback[i].instanceCount;
+	}
+	return drawn;
+}
+
+#endif
@@ -10,59 +10,49 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include "../mappedFile.h"
+#include "../assetPack.h"
 
 class Shader
 {
 public:
     unsigned int ID;
+    // binding point of the FrameData uniform block, shared by every program
+    static const GLuint FRAME_DATA_BINDING = 0;
     // constructor generates the shader on the fly
+    // defines, e.g. "#define USE_SPECULAR\n", are inserted right after the #version line of every stage
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, const std::string& defines = "")
     {
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
+        // 1. retrieve the vertex/fragment source code from the asset pack or filePath
+        std::string vertexCode = readSource(vertexPath);
+        std::string fragmentCode = readSource(fragmentPath);
         std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        try
+        // if geometry shader path is present, also load a geometry shader
+        if (geometryPath != nullptr)
+            geometryCode = readSource(geometryPath);
+        if (!defines.empty())
         {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
-            // if geometry shader path is present, also load a geometry shader
+            insertDefines(vertexCode, defines);
+            insertDefines(fragmentCode, defines);
             if (geometryPath != nullptr)
-            {
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
+                insertDefines(geometryCode, defines);
         }
-        catch (std::ifstream::failure& e)
+        // 2. reuse the program binary from an earlier run if the sources and driver are unchanged
+        std::string binaryPath = programBinaryPath(vertexPath, vertexCode, fragmentCode, geometryCode);
+        if (loadProgramBinary(binaryPath))
         {
-            std::cout << "yo";
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+            cacheUniformLocations();
+            bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+            return;
         }
         const char* vShaderCode = vertexCode.c_str();
         const char* fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
+        // 3. compile shaders
         unsigned int vertex, fragment;
         // vertex shader
         vertex = glCreateShader(GL_VERTEX_SHADER);
@@ -86,6 +76,7 @@ public:
         }
         // shader Program
         ID = glCreateProgram();
+        glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
         if (geometryPath != nullptr)
@@ -97,7 +88,36 @@ public:
         glDeleteShader(fragment);
         if (geometryPath != nullptr)
             glDeleteShader(geometry);
-
+        saveProgramBinary(binaryPath);
+        cacheUniformLocations();
+        bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+    }
+    // constructor for a compute program, read and cached the same way
+    // ------------------------------------------------------------------------
+    explicit Shader(const char* computePath, const std::string& defines = "")
+    {
+        std::string computeCode = readSource(computePath);
+        if (!defines.empty())
+            insertDefines(computeCode, defines);
+        std::string binaryPath = programBinaryPath(computePath, computeCode, "", "");
+        if (loadProgramBinary(binaryPath))
+        {
+            cacheUniformLocations();
+            return;
+        }
+        const char* cShaderCode = computeCode.c_str();
+        unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+        glShaderSource(compute, 1, &cShaderCode, NULL);
+        glCompileShader(compute);
+        checkCompileErrors(compute, "COMPUTE");
+        ID = glCreateProgram();
+        glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glAttachShader(ID, compute);
+        glLinkProgram(ID);
+        checkCompileErrors(ID, "PROGRAM");
+        glDeleteShader(compute);
+        saveProgramBinary(binaryPath);
+        cacheUniformLocations();
     }
     // activate the shader
     // ------------------------------------------------------------------------
@@ -105,66 +125,258 @@ public:
     {
         glUseProgram(ID);
     }
+    // cached uniform location lookup, resolve once outside the draw loop
+    // ------------------------------------------------------------------------
+    GLint uniform(const std::string& name) const
+    {
+        auto it = uniformLocations.find(name);
+        return it != uniformLocations.end() ? it->second : -1;
+    }
+    // attach a uniform block to a buffer binding point, if the program uses it
+    // ------------------------------------------------------------------------
+    void bindUniformBlock(const char* name, GLuint binding) const
+    {
+        GLuint index = glGetUniformBlockIndex(ID, name);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
+    }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string& name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        setBool(uniform(name), value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string& name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1i(uniform(name), value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string& name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1f(uniform(name), value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string& name, const glm::vec2& value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform2fv(uniform(name), 1, &value[0]);
     }
     void setVec2(const std::string& name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        glUniform2f(uniform(name), x, y);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string& name, const glm::vec3& value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform3fv(uniform(name), 1, &value[0]);
     }
     void setVec3(const std::string& name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        glUniform3f(uniform(name), x, y, z);
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string& name, const glm::vec4& value) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform4fv(uniform(name), 1, &value[0]);
     }
     void setVec4(const std::string& name, float x, float y, float z, float w)
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        glUniform4f(uniform(name), x, y, z, w);
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string& name, const glm::mat2& mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(uniform(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string& name, const glm::mat3& mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(uniform(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string& name, const glm::mat4& mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(uniform(name), 1, GL_FALSE, &mat[0][0]);
+    }
+    // uniform functions taking a location from uniform(), no lookup at all
+    // ------------------------------------------------------------------------
+    void setBool(GLint location, bool value) const
+    {
+        glUniform1i(location, (int)value);
+    }
+    void setInt(GLint location, int value) const
+    {
+        glUniform1i(location, value);
+    }
+    void setFloat(GLint location, float value) const
+    {
+        glUniform1f(location, value);
+    }
+    void setVec2(GLint location, const glm::vec2& value) const
+    {
+        glUniform2fv(location, 1, &value[0]);
+    }
+    void setVec3(GLint location, const glm::vec3& value) const
+    {
+        glUniform3fv(location, 1, &value[0]);
+    }
+    void setVec3(GLint location, float x, float y, float z) const
+    {
+        glUniform3f(location, x, y, z);
+    }
+    void setVec4(GLint location, const glm::vec4& value) const
+    {
+        glUniform4fv(location, 1, &value[0]);
+    }
+    void setMat3(GLint location, const glm::mat3& mat) const
+    {
+        glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat4(GLint location, const glm::mat4& mat) const
+    {
+        glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    std::unordered_map<std::string, GLint> uniformLocations;
+
+    // reads a shader source from the asset pack, or from disk when the pack does not have it
+    // ------------------------------------------------------------------------
+    static std::string readSource(const char* path)
+    {
+        Asset source(path);
+        if (!source.isOpen())
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+            return std::string();
+        }
+        return std::string((const char*)source.data(), source.size());
+    }
+
+    // #version has to stay the first statement, so defines go on the line after it
+    // ------------------------------------------------------------------------
+    static void insertDefines(std::string& code, const std::string& defines)
+    {
+        size_t position = 0;
+        if (code.compare(0, 8, "#version") == 0)
+        {
+            position = code.find('\n');
+            position = position == std::string::npos ? code.size() : position + 1;
+        }
+        code.insert(position, defines);
+    }
+
+    // header of a cached program binary, followed by the driver's blob
+    struct ProgramBinaryHeader
+    {
+        char magic[4];
+        GLenum format;
+        uint32_t size;
+    };
+
+    // key of the program binary, changes with the sources and with the driver that produced the blob
+    // ------------------------------------------------------------------------
+    static uint64_t programBinaryKey(const std::string& vertexCode, const std::string& fragmentCode, const std::string& geometryCode)
+    {
+        uint64_t key = hashBytes(vertexCode.data(), vertexCode.size());
+        key = hashBytes(fragmentCode.data(), fragmentCode.size(), key);
+        key = hashBytes(geometryCode.data(), geometryCode.size(), key);
+        const GLenum driverStrings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+        for (GLenum name : driverStrings)
+        {
+            const char* value = (const char*)glGetString(name);
+            if (value)
+                key = hashBytes(value, strlen(value), key);
+        }
+        return key;
+    }
+
+    // cached binaries live next to the vertex shader, one file per source and driver combination
+    // ------------------------------------------------------------------------
+    static std::string programBinaryPath(const char* vertexPath, const std::string& vertexCode, const std::string& fragmentCode, const std::string& geometryCode)
+    {
+        char key[17];
+        snprintf(key, sizeof(key), "%016llx", (unsigned long long)programBinaryKey(vertexCode, fragmentCode, geometryCode));
+        return std::string(vertexPath) + "." + key + ".progbin";
+    }
+
+    // creates the program from a cached binary, returns false if there is none or the driver rejects it
+    // ------------------------------------------------------------------------
+    bool loadProgramBinary(const std::string& path)
+    {
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        if (formats == 0)
+            return false;
+
+        MappedFile cached(path);
+        if (!cached.isOpen() || cached.size() < sizeof(ProgramBinaryHeader))
+            return false;
+        const ProgramBinaryHeader* header = (const ProgramBinaryHeader*)cached.data();
+        if (memcmp(header->magic, "PBIN", 4) != 0 || cached.size() != sizeof(ProgramBinaryHeader) + header->size)
+            return false;
+
+        ID = glCreateProgram();
+        glProgramBinary(ID, header->format, cached.data() + sizeof(ProgramBinaryHeader), header->size);
+        GLint success = GL_FALSE;
+        glGetProgramiv(ID, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            // drivers may refuse binaries after an update even when the version string is unchanged, compile instead
+            glDeleteProgram(ID);
+            ID = 0;
+            return false;
+        }
+        return true;
+    }
+
+    // writes the linked program's binary so the next run can skip compiling
+    // ------------------------------------------------------------------------
+    void saveProgramBinary(const std::string& path) const
+    {
+        GLint success = GL_FALSE, length = 0;
+        glGetProgramiv(ID, GL_LINK_STATUS, &success);
+        glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (!success || length <= 0)
+            return;
+
+        std::string blob(length, '\0');
+        ProgramBinaryHeader header = { { 'P', 'B', 'I', 'N' }, 0, 0 };
+        glGetProgramBinary(ID, length, &length, &header.format, &blob[0]);
+        header.size = (uint32_t)length;
+
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+            return;
+        file.write((const char*)&header, sizeof(header));
+        file.write(blob.data(), length);
+    }
+
+    // asks the linked program for all active uniforms and stores their locations
+    // ------------------------------------------------------------------------
+    void cacheUniformLocations()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::string name(maxLength, '\0');
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, i, maxLength, &length, &size, &type, &name[0]);
+            std::string uniformName = name.substr(0, length);
+            GLint location = glGetUniformLocation(ID, uniformName.c_str());
+            if (location < 0)
+                continue; // uniform block members have no location
+            uniformLocations[uniformName] = location;
+            // arrays are reported as "name[0]", also allow looking them up as "name"
+            if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0)
+                uniformLocations[uniformName.substr(0, uniformName.size() - 3)] = location;
+        }
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
@@ -0,0 +1,63 @@
+#ifndef LevelGrid_header
+#define LevelGrid_header
+
+#include <vector>
+#include <cstdint>
+
+//Cells per side of the square blocks the level is culled in. Greedy wall runs stop at chunk edges, so smaller chunks
+//cull closer to the visible corridor but cost wall vertices, and every chunk is a box tested each frame.
+const int LEVEL_CHUNK_SIZE = 8;
+
+//Wall occupancy of a level in one contiguous row-major block (rows run along z).
+//Built once by readLevel, then shared read-only by the ghosts, the player and the renderer.
+class LevelGrid {
+private:
+    std::vector<uint8_t> cells;
+    int sizeX = 0;
+    int sizeZ = 0;
+public:
+    LevelGrid() {}
+    LevelGrid(int _sizeX, int _sizeZ) : cells(_sizeX * _sizeZ, 0), sizeX(_sizeX), sizeZ(_sizeZ) {}
+
+    int getSizeX() const { return sizeX; }
+    int getSizeZ() const { return sizeZ; }
+    int getChunksX() const { return (sizeX + LEVEL_CHUNK_SIZE - 1) / LEVEL_CHUNK_SIZE; }
+    int getChunksZ() const { return (sizeZ + LEVEL_CHUNK_SIZE - 1) / LEVEL_CHUNK_SIZE; }
+
+    /// <summary>
+    /// Chunk a cell belongs to, chunks are numbered row-major like the cells
+    /// </summary>
+    int chunkOf(int x, int z) const {
+        return (z / LEVEL_CHUNK_SIZE) * getChunksX() + x / LEVEL_CHUNK_SIZE;
+    }
+
+    /// <summary>
+    /// Checks if a cell lies within the level
+    /// </summary>
+    bool inBounds(int x, int z) const {
+        return x >= 0 && x < sizeX && z >= 0 && z < sizeZ;
+    }
+
+    /// <summary>
+    /// Checks if a cell holds a wall. Cells outside the level hold nothing.
+    /// </summary>
+    bool isWall(int x, int z) const {
+        return inBounds(x, z) && cells[z * sizeX + x] != 0;
+    }
+
+    /// <summary>
+    /// Checks if a cell is inside the level and free to walk on
+    /// </summary>
+    bool isWalkable(int x, int z) const {
+        return inBounds(x, z) && cells[z * sizeX + x] == 0;
+    }
+
+    /// <summary>
+    /// Marks a cell as wall or path, only used while the level is being read
+    /// </summary>
+    void setWall(int x, int z, bool wall) {
+        if (inBounds(x, z)) cells[z * sizeX + x] = wall ? 1 : 0;
+    }
+};
+
+#endif
@@ -0,0 +1,190 @@
+#ifndef levelMesh_header
+#define levelMesh_header
+
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include "glm/glm/glm.hpp"
+#include "vaoHandler.h"
+#include "levelGrid.h"
+
+using namespace std;
+
+//One LEVEL_CHUNK_SIZE square block of the level, culled as a whole
+struct LevelChunk
+{
+	GLuint firstIndex; //Wall triangles of the chunk inside the level mesh's element buffer
+	GLuint indexCount;
+	glm::vec3 center;  //World space bounding box of the chunk's cells
+	glm::vec3 extent;
+};
+
+void generateWallMesh(const LevelGrid& grid, bool greedy, int minX, int minZ, int maxX, int maxZ, vector<Vertex>& vertices, vector<GLuint>& indices);
+GLuint buildLevelMesh(const LevelGrid& grid, bool greedy, MeshEncoding& encoding, vector<LevelChunk>& chunks);
+
+//One side of a wall cube: the neighbouring cell that hides it, its normal and its four corners
+struct WallFace
+{
+	int dx, dz;
+	glm::vec3 normal;
+	glm::vec3 corners[4];
+	glm::vec2 texCoords[4];
+};
+
+//Two triangles per side, wound the same way as the corners
+const GLuint wallFaceIndices[6] = { 0, 1, 2, 2, 3, 0 };
+
+//The four sides of a wall cube centred on its cell. Top and bottom faces are never seen so they are left out.
+const WallFace wallFaces[4] = {
+	{ 0, -1, { 0.0f, 0.0f, -1.0f },
+		{ {-0.5f, -0.5f, -0.5f}, { 0.5f, -0.5f, -0.5f}, { 0.5f,  0.5f, -0.5f}, {-0.5f,  0.5f, -0.5f} },
+		{ {0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f} } },
+	{ 0, 1, { 0.0f, 0.0f, 1.0f },
+		{ {-0.5f, -0.5f,  0.5f}, { 0.5f, -0.5f,  0.5f}, { 0.5f,  0.5f,  0.5f}, {-0.5f,  0.5f,  0.5f} },
+		{ {0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f} } },
+	{ -1, 0, { -1.0f, 0.0f, 0.0f },
+		{ {-0.5f,  0.5f,  0.5f}, {-0.5f,  0.5f, -0.5f}, {-0.5f, -0.5f, -0.5f}, {-0.5f, -0.5f,  0.5f} },
+		{ {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f}, {0.0f, 0.0f} } },
+	{ 1, 0, { 1.0f, 0.0f, 0.0f },
+		{ { 0.5f,  0.5f,  0.5f}, { 0.5f,  0.5f, -0.5f}, { 0.5f, -0.5f, -0.5f}, { 0.5f, -0.5f,  0.5f} },
+		{ {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f}, {0.0f, 0.0f} } },
+};
+
+/// <summary>
+/// Checks if a cell holds a wall. Cells outside the level count as solid,
+/// as nothing can see the outward faces of the border.
+/// </summary>
+/// <param name="grid">Level grid</param>
+/// <param name="x">x position</param>
+/// <param name="z">z position</param>
+/// <returns>true if the cell is solid</returns>
+bool isSolid(const LevelGrid& grid, int x, int z) {
+	return !grid.inBounds(x, z) || grid.isWall(x, z);
+}
+
+/// <summary>
+/// Checks if a wall side is visible, i.e. the cell is a wall and the neighbour on that side is not
+/// </summary>
+/// <param name="grid">Level grid</param>
+/// <param name="face">Side to check</param>
+/// <param name="x">x position</param>
+/// <param name="z">z position</param>
+/// <returns>true if the face should be meshed</returns>
+bool faceVisible(const LevelGrid& grid, const WallFace& face, int x, int z) {
+	return grid.isWall(x, z) && !isSolid(grid, x + face.dx, z + face.dz);
+}
+
+/// <summary>
+/// Adds one wall side spanning a run of cells as two triangles.
+/// Corners on the far end of the run are moved to the last cell and the texture coordinate
+/// running along the wall is stretched, so GL_REPEAT tiles the texture once per cell.
+/// </summary>
+/// <param name="vertices">Vertex list to append to</param>
+/// <param name="indices">Index list to append to</param>
+/// <param name="face">Side to add</param>
+/// <param name="first">Center of the first cell in the run</param>
+/// <param name="last">Center of the last cell in the run</param>
+/// <param name="length">Number of cells in the run</param>
+void addWallRun(vector<Vertex>& vertices, vector<GLuint>& indices, const WallFace& face, glm::vec3 first, glm::vec3 last, int length) {
+	bool alongX = face.dz != 0;
+	int uvAxis = alongX ? 0 : 1; //Z-facing sides map x to u, X-facing sides map z to v
+
+	GLuint base = vertices.size();
+	for (int i = 0; i < 6; i++) {
+		indices.push_back(base + wallFaceIndices[i]);
+	}
+	for (int i = 0; i < 4; i++) {
+		glm::vec3 corner = face.corners[i];
+		bool farEnd = (alongX ? corner.x : corner.z) > 0;
+		glm::vec2 texCoord = face.texCoords[i];
+		texCoord[uvAxis] *= length;
+
+		vertices.push_back({ (farEnd ? last : first) + corner, face.normal, texCoord });
+	}
+}
+
+/// <summary>
+/// Generates the visible wall sides of a rectangle of the level.
+/// Faces shared by two wall cells can never be seen and are dropped.
+/// With greedy meshing, coplanar sides of neighbouring cells are merged into one long quad,
+/// so the vertex count follows the number of straight wall runs instead of the number of cells.
+/// Runs stop at the edge of the rectangle, so every chunk gets its own triangles.
+/// </summary>
+/// <param name="grid">Level grid</param>
+/// <param name="greedy">Merge coplanar neighbouring faces</param>
+/// <param name="minX">First cell along x</param>
+/// <param name="minZ">First cell along z</param>
+/// <param name="maxX">Cell after the last one along x</param>
+/// <param name="maxZ">Cell after the last one along z</param>
+/// <param name="vertices">Wall vertices in world space, appended to by the function</param>
+/// <param name="indices">Triangle list indexing vertices, appended to by the function</param>
+void generateWallMesh(const LevelGrid& grid, bool greedy, int minX, int minZ, int maxX, int maxZ, vector<Vertex>& vertices, vector<GLuint>& indices) {
+	for (auto& face : wallFaces) {
+		//Sides facing along z lie in rows of constant z and run along x, and the other way around
+		bool alongX = face.dz != 0;
+		int firstLine = alongX ? minZ : minX;
+		int lines = alongX ? maxZ : maxX;
+		int start = alongX ? minX : minZ;
+		int length = alongX ? maxX : maxZ;
+
+		for (int line = firstLine; line < lines; line++) {
+			int i = start;
+			while (i < length) {
+				int x = alongX ? i : line;
+				int z = alongX ? line : i;
+				if (!faceVisible(grid, face, x, z)) { i++; continue; }
+
+				//Extend the run while the next cell has the same side visible
+				int end = i + 1;
+				while (greedy && end < length && faceVisible(grid, face, alongX ? end : line, alongX ? line : end)) end++;
+
+				glm::vec3 first = glm::vec3(x, 0, z);
+				glm::vec3 last = alongX ? glm::vec3(end - 1, 0, z) : glm::vec3(x, 0, end - 1);
+				addWallRun(vertices, indices, face, first, last, end - i);
+				i = end;
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Merges every wall of a level into one static VAO, with the triangles of each chunk kept in one index range
+/// so chunks outside the view can be skipped
+/// </summary>
+/// <param name="grid">Level grid</param>
+/// <param name="greedy">Merge coplanar neighbouring faces</param>
+/// <param name="encoding">Vertex layout to upload with, updated with the layout actually used and its position decode</param>
+/// <param name="chunks">Index range and bounds of every chunk in LevelGrid::chunkOf order, filled by the function</param>
+/// <returns>Newly generated VAO for the walls</returns>
+GLuint buildLevelMesh(const LevelGrid& grid, bool greedy, MeshEncoding& encoding, vector<LevelChunk>& chunks) {
+	vector<Vertex> vertices;
+	vector<GLuint> indices;
+	chunks.clear();
+	for (int chunkZ = 0; chunkZ < grid.getChunksZ(); chunkZ++) {
+		for (int chunkX = 0; chunkX < grid.getChunksX(); chunkX++) {
+			int minX = chunkX * LEVEL_CHUNK_SIZE, minZ = chunkZ * LEVEL_CHUNK_SIZE;
+			int maxX = min(minX + LEVEL_CHUNK_SIZE, grid.getSizeX()), maxZ = min(minZ + LEVEL_CHUNK_SIZE, grid.getSizeZ());
+
+			LevelChunk chunk;
+			chunk.firstIndex = indices.size();
+			generateWallMesh(grid, greedy, minX, minZ, maxX, maxZ, vertices, indices);
+			chunk.indexCount = indices.size() - chunk.firstIndex;
+
+			//Cells are centred on their coordinates, walls and pellets stay within half a unit of the floor plane
+			glm::vec3 low = glm::vec3(minX - 0.5f, -0.5f, minZ - 0.5f);
+			glm::vec3 high = glm::vec3(maxX - 0.5f, 0.5f, maxZ - 0.5f);
+			chunk.center = (low + high) * 0.5f;
+			chunk.extent = (high - low) * 0.5f;
+			chunks.push_back(chunk);
+		}
+	}
+	cout << "Level mesh" << (greedy ? " (greedy)" : "") << ": " << vertices.size() << " vertices, " << indices.size() << " indices in "
+		<< chunks.size() << " chunks" << endl;
+
+	//Same vertex layouts and attribute setup as the models
+	GLuint VAO = uploadModel(vertices.data(), vertices.size(), indices.data(), indices.size(), encoding);
+
+	return VAO;
+}
+
+#endif
@@ -0,0 +1,177 @@
+#ifndef levelPvs_header
+#define levelPvs_header
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include "glm/glm/glm.hpp"
+#include "levelGrid.h"
+#include "levelVisibility.h"
+#include "assetPack.h"
+
+using namespace std;
+
+//Potentially visible sets written by the PvsBuilder tool next to a level as <level>.pvs:
+//a header, one PvsCell per grid cell in row-major order, then the run data of every cell.
+//A cell's set covers its bounding rectangle row by row, as alternating run lengths of hidden and visible cells
+//starting with hidden ones, each length a LEB128 varint.
+struct PvsHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t sizeX;
+	uint32_t sizeZ;
+	uint32_t radius;   //Longest line of sight the sets were built with
+	uint32_t dataSize; //Bytes of run data after the cell table
+	uint64_t sourceHash;
+	int64_t sourceTime;
+	uint64_t sourceSize;
+};
+
+struct PvsCell
+{
+	uint32_t offset; //Into the run data
+	uint32_t size;   //0 for cells nothing can stand in
+	uint16_t minX, minZ, maxX, maxZ;
+};
+
+const char PVS_MAGIC[4] = { 'P', 'P', 'V', 'S' };
+const uint32_t PVS_VERSION = 1;
+
+PvsCell encodePvsCell(const LevelGrid& grid, const LevelVisibility& visibility, vector<uint8_t>& data);
+void decodePvsCell(const PvsCell& cell, const uint8_t* runs, const LevelGrid& grid, LevelVisibility& visibility);
+const PvsHeader* pvsHeader(const Asset& pvs, const string& levelPath, const LevelGrid& grid);
+bool applyPvs(const PvsHeader* header, const LevelGrid& grid, glm::vec3 eye, LevelVisibility& visibility);
+
+/// <summary>
+/// Cell table following the header
+/// </summary>
+inline const PvsCell* pvsCells(const PvsHeader* header) {
+	return (const PvsCell*)(header + 1);
+}
+
+/// <summary>
+/// Compresses the visible cells of a visibility into runs over their bounding rectangle
+/// </summary>
+/// <param name="grid">Level grid</param>
+/// <param name="visibility">Cells seen from one cell</param>
+/// <param name="data">Run data, appended to by the function</param>
+/// <returns>Cell record, with the offset of its runs within data</returns>
+PvsCell encodePvsCell(const LevelGrid& grid, const LevelVisibility& visibility, vector<uint8_t>& data) {
+	PvsCell cell = {};
+	cell.offset = data.size();
+	if (visibility.visibleCells == 0) return cell;
+	cell.minX = visibility.minX;
+	cell.minZ = visibility.minZ;
+	cell.maxX = visibility.maxX;
+	cell.maxZ = visibility.maxZ;
+
+	auto writeRun = [&](uint32_t length) {
+		do {
+			uint8_t byte = length & 0x7F;
+			length >>= 7;
+			data.push_back(byte | (length ? 0x80 : 0));
+		} while (length);
+	};
+
+	bool visible = false;
+	uint32_t run = 0;
+	for (int z = cell.minZ; z <= cell.maxZ; z++) {
+		for (int x = cell.minX; x <= cell.maxX; x++) {
+			if (visibility.isVisible(grid, x, z) != visible) {
+				writeRun(run);
+				visible = !visible;
+				run = 0;
+			}
+			run++;
+		}
+	}
+	writeRun(run);
+
+	cell.size = data.size() - cell.offset;
+	return cell;
+}
+
+/// <summary>
+/// Marks the visible cells of one encoded set, on top of the cells already marked
+/// </summary>
+/// <param name="cell">Cell record</param>
+/// <param name="runs">Start of the cell's run data</param>
+/// <param name="grid">Level grid</param>
+/// <param name="visibility">Visibility to mark</param>
+void decodePvsCell(const PvsCell& cell, const uint8_t* runs, const LevelGrid& grid, LevelVisibility& visibility) {
+	const uint8_t* end = runs + cell.size;
+	int width = cell.maxX - cell.minX + 1;
+	int area = width * (cell.maxZ - cell.minZ + 1);
+	int position = 0;
+	bool visible = false;
+	while (runs < end && position < area) {
+		uint32_t length = 0;
+		for (int shift = 0; runs < end && shift < 32; shift += 7) {
+			uint8_t byte = *runs++;
+			length |= (uint32_t)(byte & 0x7F) << shift;
+			if (!(byte & 0x80)) break;
+		}
+		length = min(length, (uint32_t)(area - position));
+		if (visible) {
+			for (int i = position; i < position + (int)length; i++) {
+				visibility.mark(grid, cell.minX + i % width, cell.minZ + i / width);
+			}
+		}
+		position += length;
+		visible = !visible;
+	}
+}
+
+/// <summary>
+/// Checks a potentially visible set file for consistency and against the level it was built from, see sourceUnchanged
+/// </summary>
+/// <param name="pvs">Potentially visible set file</param>
+/// <param name="levelPath">Level it was built from</param>
+/// <param name="grid">Grid read from the level</param>
+/// <returns>Header of the sets, or nullptr if they are missing, corrupt or stale</returns>
+const PvsHeader* pvsHeader(const Asset& pvs, const string& levelPath, const LevelGrid& grid) {
+	if (!pvs.isOpen() || pvs.size() < sizeof(PvsHeader)) return nullptr;
+
+	const PvsHeader* header = (const PvsHeader*)pvs.data();
+	if (memcmp(header->magic, PVS_MAGIC, 4) != 0 || header->version != PVS_VERSION) return nullptr;
+	if (header->sizeX != (uint32_t)grid.getSizeX() || header->sizeZ != (uint32_t)grid.getSizeZ()) return nullptr;
+	uint64_t cellCount = (uint64_t)header->sizeX * header->sizeZ;
+	if (pvs.size() < sizeof(PvsHeader) + sizeof(PvsCell) * cellCount + header->dataSize) return nullptr;
+
+	const PvsCell* cells = pvsCells(header);
+	for (uint64_t i = 0; i < cellCount; i++) {
+		if ((uint64_t)cells[i].offset + cells[i].size > header->dataSize) return nullptr;
+		if (cells[i].size > 0 && (cells[i].maxX >= header->sizeX || cells[i].maxZ >= header->sizeZ)) return nullptr;
+	}
+
+	return sourceUnchanged(levelPath, header->sourceSize, header->sourceTime, header->sourceHash) ? header : nullptr;
+}
+
+/// <summary>
+/// Marks the cells visible from the camera's cell straight from its precomputed set.
+/// The set only changes when the camera moves to another cell, so other frames keep the cells marked before.
+/// </summary>
+/// <param name="header">Sets of the level, see pvsHeader</param>
+/// <param name="grid">Level grid</param>
+/// <param name="eye">Camera position</param>
+/// <param name="visibility">Visibility to fill</param>
+/// <returns>false if there is no set for the camera's cell and the caller has to raycast</returns>
+bool applyPvs(const PvsHeader* header, const LevelGrid& grid, glm::vec3 eye, LevelVisibility& visibility) {
+	int eyeX = (int)floor(eye.x + 0.5f), eyeZ = (int)floor(eye.z + 0.5f);
+	if (!grid.inBounds(eyeX, eyeZ)) return false;
+	int cellIndex = eyeZ * grid.getSizeX() + eyeX;
+	if (visibility.sourceCell == cellIndex) return true;
+
+	const PvsCell& cell = pvsCells(header)[cellIndex];
+	if (cell.size == 0) return false;
+
+	visibility.begin();
+	visibility.sourceCell = cellIndex;
+	const uint8_t* data = (const uint8_t*)(pvsCells(header) + (size_t)header->sizeX * header->sizeZ);
+	decodePvsCell(cell, data + cell.offset, grid, visibility);
+	return true;
+}
+
+#endif
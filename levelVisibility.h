@@ -0,0 +1,194 @@
+#ifndef levelVisibility_header
+#define levelVisibility_header
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <climits>
+#include <algorithm>
+#include "glm/glm/glm.hpp"
+#include "levelGrid.h"
+
+using namespace std;
+
+//Cells and chunks of the level seen from the camera this frame.
+//Cells and chunks are marked with the frame number, so nothing has to be cleared between frames however large the level is.
+struct LevelVisibility
+{
+	vector<uint32_t> cellFrames;
+	vector<uint32_t> chunkFrames; //Frame of the last visible cell in every chunk, in LevelGrid::chunkOf order
+	uint32_t frame = 0;
+	int visibleCells = 0;
+	int minX = INT_MAX, minZ = INT_MAX, maxX = INT_MIN, maxZ = INT_MIN; //Bounds of the visible cells
+	int sourceCell = -1; //Cell a precomputed set was last taken from, -1 when the frame was raycast
+
+	LevelVisibility() {}
+	LevelVisibility(const LevelGrid& grid)
+		: cellFrames(grid.getSizeX() * grid.getSizeZ(), 0), chunkFrames(grid.getChunksX() * grid.getChunksZ(), 0) {}
+
+	//Forgets the previous frame's cells
+	void begin() {
+		frame++;
+		visibleCells = 0;
+		minX = minZ = INT_MAX;
+		maxX = maxZ = INT_MIN;
+		sourceCell = -1;
+	}
+
+	bool isVisible(const LevelGrid& grid, int x, int z) const {
+		return grid.inBounds(x, z) && cellFrames[z * grid.getSizeX() + x] == frame;
+	}
+
+	void mark(const LevelGrid& grid, int x, int z) {
+		if (!grid.inBounds(x, z)) return;
+		uint32_t& cellFrame = cellFrames[z * grid.getSizeX() + x];
+		if (cellFrame == frame) return;
+		cellFrame = frame;
+		chunkFrames[grid.chunkOf(x, z)] = frame;
+		visibleCells++;
+		minX = min(minX, x);
+		minZ = min(minZ, z);
+		maxX = max(maxX, x);
+		maxZ = max(maxZ, z);
+	}
+};
+
+void viewWedge(const glm::mat4& viewProjection, glm::vec3 eye, float& firstAngle, float& lastAngle);
+float castVisibilityRay(const LevelGrid& grid, glm::vec2 origin, glm::vec2 direction, float maxDistance, LevelVisibility& visibility);
+void castVisibility(const LevelGrid& grid, const glm::mat4& viewProjection, glm::vec3 eye, float maxDistance, LevelVisibility& visibility);
+bool sphereCellsVisible(const LevelGrid& grid, const LevelVisibility& visibility, glm::vec3 center, float radius);
+
+/// <summary>
+/// Range of horizontal directions the view frustum covers around the eye, from the frustum's corners projected onto the floor.
+/// When the frustum reaches around the eye (looking steeply up or down) the whole circle is returned.
+/// </summary>
+/// <param name="viewProjection">Projection times view</param>
+/// <param name="eye">Camera position</param>
+/// <param name="firstAngle">First direction as an angle around y, filled by the function</param>
+/// <param name="lastAngle">Last direction, never more than a full turn after firstAngle</param>
+void viewWedge(const glm::mat4& viewProjection, glm::vec3 eye, float& firstAngle, float& lastAngle) {
+	const float PI = 3.14159265f;
+	glm::mat4 inverse = glm::inverse(viewProjection);
+
+	//Angles are taken relative to the direction towards the far plane's center, so the wedge never wraps around
+	glm::vec4 farCenter = inverse * glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	glm::vec2 forward = glm::vec2(farCenter.x, farCenter.z) / farCenter.w - glm::vec2(eye.x, eye.z);
+	float forwardAngle = atan2(forward.y, forward.x);
+
+	float low = 0.0f, high = 0.0f;
+	for (int corner = 0; corner < 8; corner++) {
+		glm::vec4 ndc = glm::vec4(corner & 1 ? 1.0f : -1.0f, corner & 2 ? 1.0f : -1.0f, corner & 4 ? 1.0f : -1.0f, 1.0f);
+		glm::vec4 world = inverse * ndc;
+		glm::vec2 offset = glm::vec2(world.x, world.z) / world.w - glm::vec2(eye.x, eye.z);
+		float angle = atan2(offset.y, offset.x) - forwardAngle;
+		if (angle > PI) angle -= 2 * PI;
+		if (angle < -PI) angle += 2 * PI;
+		low = min(low, angle);
+		high = max(high, angle);
+	}
+
+	if (high - low >= PI) {
+		firstAngle = 0.0f;
+		lastAngle = 2 * PI;
+		return;
+	}
+	firstAngle = forwardAngle + low;
+	lastAngle = forwardAngle + high;
+}
+
+/// <summary>
+/// Walks the grid cell by cell along a ray (DDA) and marks every cell it passes until it hits a wall.
+/// Walls bordering a crossed floor cell are marked as well: their sides face that cell, and it catches walls seen at grazing angles between two rays.
+/// </summary>
+/// <param name="grid">Level grid</param>
+/// <param name="origin">Ray start on the floor, x and z in world space</param>
+/// <param name="direction">Unit ray direction</param>
+/// <param name="maxDistance">Length of the ray</param>
+/// <param name="visibility">Visibility to mark</param>
+/// <returns>Distance the ray travelled before it was stopped</returns>
+float castVisibilityRay(const LevelGrid& grid, glm::vec2 origin, glm::vec2 direction, float maxDistance, LevelVisibility& visibility) {
+	//Cells are centred on integer coordinates, move to a grid where they start on them
+	glm::vec2 start = origin + 0.5f;
+	int x = (int)floor(start.x);
+	int z = (int)floor(start.y);
+	int stepX = direction.x > 0 ? 1 : -1;
+	int stepZ = direction.y > 0 ? 1 : -1;
+
+	//Distance along the ray between two cell borders, and to the next border, per axis
+	float deltaX = direction.x != 0 ? abs(1.0f / direction.x) : INFINITY;
+	float deltaZ = direction.y != 0 ? abs(1.0f / direction.y) : INFINITY;
+	float nextX = (direction.x > 0 ? x + 1 - start.x : start.x - x) * deltaX;
+	float nextZ = (direction.y > 0 ? z + 1 - start.y : start.y - z) * deltaZ;
+
+	float distance = 0.0f;
+	while (distance <= maxDistance && grid.inBounds(x, z)) {
+		visibility.mark(grid, x, z);
+		if (grid.isWall(x, z)) return distance;
+		visibility.mark(grid, x + 1, z);
+		visibility.mark(grid, x - 1, z);
+		visibility.mark(grid, x, z + 1);
+		visibility.mark(grid, x, z - 1);
+
+		if (nextX < nextZ) {
+			distance = nextX;
+			nextX += deltaX;
+			x += stepX;
+		}
+		else {
+			distance = nextZ;
+			nextZ += deltaZ;
+			z += stepZ;
+		}
+	}
+	return min(distance, maxDistance);
+}
+
+/// <summary>
+/// Finds the cells visible from the camera by casting rays over the grid across the view frustum's horizontal wedge.
+/// Rays are spaced so neighbouring ones are at most half a cell apart at the far end.
+/// </summary>
+/// <param name="grid">Level grid</param>
+/// <param name="viewProjection">Projection times view</param>
+/// <param name="eye">Camera position</param>
+/// <param name="maxDistance">Furthest a ray goes, the far plane distance</param>
+/// <param name="visibility">Visibility to fill, starts a new frame</param>
+void castVisibility(const LevelGrid& grid, const glm::mat4& viewProjection, glm::vec3 eye, float maxDistance, LevelVisibility& visibility) {
+	visibility.begin();
+
+	//The camera can be near the edge of its cell, where rays leave through a corner, so its neighbours are always kept
+	glm::vec2 origin = glm::vec2(eye.x, eye.z);
+	int eyeX = (int)floor(eye.x + 0.5f), eyeZ = (int)floor(eye.z + 0.5f);
+	for (int z = eyeZ - 1; z <= eyeZ + 1; z++) {
+		for (int x = eyeX - 1; x <= eyeX + 1; x++) {
+			visibility.mark(grid, x, z);
+		}
+	}
+
+	float firstAngle, lastAngle;
+	viewWedge(viewProjection, eye, firstAngle, lastAngle);
+	float step = 0.5f / maxDistance;
+	int rays = (int)ceil((lastAngle - firstAngle) / step) + 1;
+	for (int ray = 0; ray < rays; ray++) {
+		float angle = firstAngle + (lastAngle - firstAngle) * ray / (float)(rays - 1);
+		castVisibilityRay(grid, origin, glm::vec2(cos(angle), sin(angle)), maxDistance, visibility);
+	}
+}
+
+/// <summary>
+/// Checks if any cell under a bounding sphere's footprint is visible
+/// </summary>
+/// <param name="grid">Level grid</param>
+/// <param name="visibility">This frame's visibility</param>
+/// <param name="center">Sphere center</param>
+/// <param name="radius">Sphere radius</param>
+/// <returns>true if the object may be seen</returns>
+bool sphereCellsVisible(const LevelGrid& grid, const LevelVisibility& visibility, glm::vec3 center, float radius) {
+	for (int z = (int)floor(center.z - radius + 0.5f); z <= (int)floor(center.z + radius + 0.5f); z++) {
+		for (int x = (int)floor(center.x - radius + 0.5f); x <= (int)floor(center.x + radius + 0.5f); x++) {
+			if (visibility.isVisible(grid, x, z)) return true;
+		}
+	}
+	return false;
+}
+
+#endif
@@ -3,10 +3,8 @@
 #include <fstream>
 #include <vector>
 #include <set>
-
-// Texture loader
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
+#include <algorithm>
+#include <memory>
 
 //LearnOPENGL.com header files
 #include "learnopengl/shader_m.h"
@@ -15,27 +13,70 @@
 //Custom classes etc
 #include "ghost.h"
 #include "player.h"
+#include "pellets.h"
+#include "levelGrid.h"
 #include "vaoHandler.h"
+#include "levelMesh.h"
+#include "allocationCounter.h"
+#include "frameData.h"
+#include "textureLoader.h"
+#include "shaderVariants.h"
+#include "assetPack.h"
+#include "frustum.h"
+#include "levelVisibility.h"
+#include "levelPvs.h"
+#include "gpuCulling.h"
 
 using namespace std;
 
+//Elements submitted after culling out of the ones that could be drawn, reported whenever a frame differs from the one before
+struct CullCounts
+{
+	int cells = 0, cellsVisible = 0;
+	int wallChunks = 0, wallChunksSubmitted = 0;
+	int pellets = 0, pelletsSubmitted = 0;
+	int ghosts = 0, ghostsSubmitted = 0;
+
+	bool operator!=(const CullCounts& other) const {
+		return cells != other.cells || cellsVisible != other.cellsVisible
+			|| wallChunks != other.wallChunks || wallChunksSubmitted != other.wallChunksSubmitted
+			|| pellets != other.pellets || pelletsSubmitted != other.pelletsSubmitted
+			|| ghosts != other.ghosts || ghostsSubmitted != other.ghostsSubmitted;
+	}
+};
+
 //Methods
-unsigned int initializeTexture(string path);
-void drawElements(vector<glm::vec3> elements, unsigned int texture, GLuint VAO, float scale, int vectorSize, Shader mainShader);
+void sortChunksFrontToBack(glm::vec3 camera, vector<int>& order, vector<int>& bucketStarts);
+void writeChunkCommands(const vector<LevelChunk>& chunks, const vector<int>& order, const vector<uint8_t>& visible, int pelletSize,
+	vector<DrawElementsIndirectCommand>& commands, int& wallCommands, CullCounts& counts);
+void drawIndirect(GLuint VAO, int firstCommand, int commandCount, Shader& shader);
+void drawLods(const int* lodInstances, GLuint VAO, const vector<MeshLod>& lods, Shader& shader);
+int selectLod(glm::vec3 position, float radius, glm::vec3 camera, int lodCount);
+unsigned int vertexFeatures(const MeshEncoding& encoding);
 void mouseCallback(GLFWwindow* window, double xpos, double ypos);
+void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
 void readLevel(string path);
+void simulate(float dt, InstanceBuffer& pelletInstances, GpuCulling* gpuCulling, int pelletBatch);
 int initialize();
 
+//Assets, served from the pack when it exists and from loose files otherwise
+const bool USE_ASSET_PACK = true; // Turn off to work on loose files without rebuilding the pack
+AssetPack assets;
+const string LEVEL_PATH = "../../../levels/level0";
+
 //World variables
-vector<glm::vec3> level;
-vector<glm::vec3> pellets;
-vector<vector<int>> ghostLvl;
+Pellets pellets;
+LevelGrid levelGrid;
 vector<Ghost*> ghosts;
-vector<glm::vec3> ghostPos;
+vector<glm::vec3> ghostPos; // Instance order, grouped by level of detail
+vector<int> ghostLod;
 Player* player;
 
 //Game logic variables
-float deltaTime = 0.0f;	// Time between current frame and last frame
+const float SIMULATION_HZ = 60.0f; // Game logic ticks per second, independent of the frame rate
+const float SIMULATION_STEP = 1.0f / SIMULATION_HZ;
+const float MAX_FRAME_TIME = 0.25f; // Longest hitch the simulation tries to catch up on
+float accumulator = 0.0f; // Frame time not yet consumed by simulation ticks
 float lastFrame = 0.0f; // Time of last frame
 bool win = false;
 bool gameOver = false;
@@ -45,84 +86,279 @@ const float WIDTH = 1920;
 const float HEIGHT = 1080;
 GLFWwindow* window;
 
+//Rendering options
+const bool GREEDY_WALLS = true; // Merge straight wall runs into single quads
+const bool USE_PBO_UPLOAD = true; // Stream texture uploads through a pixel buffer object
+const bool PACKED_VERTICES = true; // Upload meshes as 16 byte quantized vertices instead of 32 byte float ones
+const int TEXTURE_LAYER_SIZE = 1024; // Width and height every texture is resized to when decoded into the texture array
+const float FIELD_OF_VIEW = 45.0f; // Vertical, in degrees
+const float VIEW_DISTANCE = 100.0f; // Far plane
+const bool GRID_VISIBILITY = true; // Only draw the cells the player's line of sight over the maze reaches, not everything in the frustum
+const bool GPU_CULLING = false; // Cull walls, pellets and ghosts in a compute shader against the frustum and last frame's depth instead of on the CPU
+const float PELLET_RADIUS = 0.15f; // Bounding sphere of a scaled pellet, for GPU culling
+const bool DEPTH_PREPASS = false; // Lay down depth with a shading-free pass first, so the lit pass shades every pixel once. Toggled with P.
+
+//Render toggles, flipped from the keyboard
+bool depthPrepass = DEPTH_PREPASS;
+bool showOverdraw = false; // O: draw every shaded fragment as an additive step instead of lighting it, and report fragments shaded per pixel
+
+//Ghost levels of detail
+const int GHOST_LODS = 4; // Full detail and three levels with half the triangles of the one before
+const float GHOST_RADIUS = 1.2f; // Bounding sphere of a scaled ghost around its origin at the feet
+const float GHOST_FOOTPRINT = 0.4f; // Half width of a scaled ghost on the floor, for finding the cells it stands in
+const float LOD_FULL_DETAIL_PIXELS = 400.0f; // Screen height at and above which full detail is drawn, every halving drops a level
+
+//Texture array layers
+const int WALL_LAYER = 0;
+const int PELLET_LAYER = 1;
+const int GHOST_LAYER = 2;
+
 int main() {
 
-	readLevel("../../../levels/level0");
+	//One mapping for every asset, built by the PackAssets target
+	if (USE_ASSET_PACK && assets.open("../../../assets.pack")) {
+		cout << "Asset pack: " << assets.size() << " files" << endl;
+	}
+
+	readLevel(LEVEL_PATH);
 
 	//initalizes all the libraries used
 	if (initialize() == EXIT_FAILURE) {
 		return EXIT_FAILURE;
 	}
 
-	// build and compile our shader program
-	Shader ourShader("../../../shaders/7.1.camera.vs", "../../../shaders/7.1.camera.frag");
-
-	// load and create a texture from path
-	unsigned int wallTexture = initializeTexture("../../../../resources/textures/wall.jpg");
-	unsigned int pelletTexture = initializeTexture("../../../../resources/textures/yellow.jpg");
-	unsigned int ghostTexture = initializeTexture("../../../../resources/textures/tex.jpg");
+	// load every texture into one texture array, in layer order, decoded in parallel
+	GLuint textureArray = loadTextureArray({
+		"../../../../resources/textures/wall.jpg",
+		"../../../../resources/textures/yellow.jpg",
+		"../../../../resources/textures/tex.jpg" }, TEXTURE_LAYER_SIZE, USE_PBO_UPLOAD);
 
 	//Loads in and creates VAO for all models
-	int pelletSize = 0, ghostSize = 0;
-	GLuint wallVAO = wallSegment();
-	GLuint pelletVAO = loadModel("../../../resources/model/pellets/", "globe-sphere.obj", pelletSize);
-	GLuint ghostVAO = loadModel("../../../resources/model/ghost/","pacman-ghosts.obj", ghostSize);
+	int pelletSize = 0;
+	vector<LevelChunk> levelChunks;
+	vector<MeshLod> ghostLods;
+	MeshEncoding wallEncoding, pelletEncoding, ghostEncoding;
+	wallEncoding.format = pelletEncoding.format = ghostEncoding.format = PACKED_VERTICES ? VERTEX_PACKED : VERTEX_FLOAT;
+	wallEncoding.textureSize = pelletEncoding.textureSize = ghostEncoding.textureSize = TEXTURE_LAYER_SIZE;
+	GLuint wallVAO = buildLevelMesh(levelGrid, GREEDY_WALLS, wallEncoding, levelChunks);
+	GLuint pelletVAO = loadModel("../../../resources/model/pellets/", "globe-sphere.obj", pelletSize, pelletEncoding);
+	GLuint ghostVAO = loadModel("../../../resources/model/ghost/","pacman-ghosts.obj", ghostLods, GHOST_LODS, ghostEncoding);
+
+	// shader variants, compiled the first time a feature set is requested. Each mesh needs the one matching its vertex layout.
+	// tell opengl for each sampler to which texture unit it belongs to (only has to be done once per variant)
+	ShaderVariants shaders("../../../shaders/7.1.camera.vs", "../../../shaders/7.1.camera.frag",
+		[](Shader& shader) { shader.setInt("texture1", 0); });
+	Shader& wallShader = shaders.get(SHADER_SPECULAR | SHADER_TEXTURE | vertexFeatures(wallEncoding)); // one world space mesh, no instance data needed
+	Shader& pelletShader = shaders.get(SHADER_TEXTURE | SHADER_INSTANCING | vertexFeatures(pelletEncoding)); // too small on screen for highlights to show
+	Shader& ghostShader = shaders.get(SHADER_SPECULAR | SHADER_TEXTURE | SHADER_INSTANCING | vertexFeatures(ghostEncoding));
+	Shader& wallDepthShader = shaders.get(SHADER_DEPTH_ONLY | vertexFeatures(wallEncoding)); // depth pre-pass
+	Shader& pelletDepthShader = shaders.get(SHADER_DEPTH_ONLY | SHADER_INSTANCING | vertexFeatures(pelletEncoding));
+	Shader& ghostDepthShader = shaders.get(SHADER_DEPTH_ONLY | SHADER_INSTANCING | vertexFeatures(ghostEncoding));
+	Shader& wallOverdrawShader = shaders.get(SHADER_OVERDRAW | vertexFeatures(wallEncoding)); // overdraw visualisation
+	Shader& pelletOverdrawShader = shaders.get(SHADER_OVERDRAW | SHADER_INSTANCING | vertexFeatures(pelletEncoding));
+	Shader& ghostOverdrawShader = shaders.get(SHADER_OVERDRAW | SHADER_INSTANCING | vertexFeatures(ghostEncoding));
+
+	//Per-instance transforms, uploaded once and patched as elements move or get eaten
+	for (int i = 0; i < 4; i++) { ghostPos.push_back(glm::vec3(0, 0, 0)); } // Initialize ghost position vector
+	ghostLod.resize(ghostPos.size());
+	InstanceBuffer pelletInstances = createInstanceBuffer(pelletVAO, pellets.getPositions(), 0.3f, PELLET_LAYER, pelletEncoding.decode);
+	InstanceBuffer ghostInstances = createInstanceBuffer(ghostVAO, ghostPos, 0.75f, GHOST_LAYER, ghostEncoding.decode);
+
+	//Chunk bounds for the frustum test, and the draw stream the visible chunks' walls and pellets are written to every frame
+	BoxSet chunkBounds;
+	for (auto& chunk : levelChunks) {
+		chunkBounds.add(chunk.center, chunk.extent);
+	}
+	vector<uint8_t> chunkVisible(chunkBounds.count);
+	vector<int> chunkOrder(levelChunks.size()); // Front to back, sorted every frame
+	vector<int> chunkBuckets;
+	vector<DrawElementsIndirectCommand> drawCommands;
+	drawCommands.reserve(levelChunks.size() * 2); // One wall and one pellet command per chunk at most
+	GLuint indirectBuffer = createIndirectBuffer(drawCommands.capacity());
+	LevelVisibility visibility(levelGrid);
+
+	//Visible cells precomputed for every cell by the BuildPvs target. Without them, or once the level changed, visibility is raycast every frame.
+	Asset levelPvs(LEVEL_PATH + ".pvs");
+	const PvsHeader* pvs = GRID_VISIBILITY ? pvsHeader(levelPvs, LEVEL_PATH, levelGrid) : nullptr;
+	if (pvs) {
+		cout << "Visibility sets: " << pvs->dataSize << " bytes, built for a view distance of " << pvs->radius << endl;
+	}
+
+	//Optional GPU path: every wall chunk, pellet and ghost is an object in a storage buffer, and a compute shader
+	//writes the draw commands and compacted instances itself. The CPU work per frame stays the same however large the level is.
+	unique_ptr<GpuCulling> gpuCulling;
+	int wallBatch = 0, pelletBatch = 0, ghostBatch = 0;
+	int wallChunkCount = 0;
+	int framebufferWidth, framebufferHeight;
+	glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+	if (GPU_CULLING) {
+		gpuCulling.reset(new GpuCulling("../../../shaders/cull.comp", "../../../shaders/hiz.comp", framebufferWidth, framebufferHeight));
+		vector<CullObject> objects;
+		vector<DrawElementsIndirectCommand> commands;
+
+		//One object and one command per chunk with walls, the wall mesh has no instance data
+		for (auto& chunk : levelChunks) {
+			if (chunk.indexCount == 0) continue;
+			objects.push_back({ glm::vec4(chunk.center, glm::length(chunk.extent)), (GLint)commands.size(), -1, {} });
+			commands.push_back({ chunk.indexCount, 0, chunk.firstIndex, 0, 0 });
+		}
+		wallBatch = gpuCulling->addBatch(objects, commands, wallVAO, 0, 0);
+		wallChunkCount = commands.size();
+
+		//One object per pellet slot, all drawn by a single command
+		objects.clear();
+		commands.clear();
+		const vector<glm::vec3>& pelletPositions = pellets.getPositions();
+		for (int i = 0; i < pelletPositions.size(); i++) {
+			objects.push_back({ glm::vec4(pelletPositions[i], PELLET_RADIUS), 0, i, {} });
+		}
+		commands.push_back({ (GLuint)pelletSize, 0, 0, 0, 0 });
+		pelletBatch = gpuCulling->addBatch(objects, commands, pelletVAO, pelletInstances.VBO, pelletPositions.size());
+
+		//Ghosts pick their level of detail on the GPU, every level has room for all of them in the culled instance buffer
+		objects.clear();
+		commands.clear();
+		for (int i = 0; i < ghosts.size(); i++) {
+			objects.push_back({ glm::vec4(ghosts[i]->getPosition(0.0f), GHOST_RADIUS), -1, i, {} });
+		}
+		for (int lod = 0; lod < ghostLods.size(); lod++) {
+			commands.push_back({ ghostLods[lod].indexCount, 0, ghostLods[lod].firstIndex, 0, (GLuint)(lod * ghosts.size()) });
+		}
+		ghostBatch = gpuCulling->addBatch(objects, commands, ghostVAO, ghostInstances.VBO, ghostLods.size() * ghosts.size());
+		gpuCulling->finishBatches();
+		gpuCulling->setLodSelection(ghostLods.size(), HEIGHT / tan(glm::radians(FIELD_OF_VIEW) / 2), LOD_FULL_DETAIL_PIXELS);
+	}
+
+	//Wall mesh is already in world space, its model (just the position decode) and layer are plain uniforms
+	for (Shader* shader : { &wallShader, &wallDepthShader, &wallOverdrawShader }) {
+		shader->use();
+		shader->setMat4("aModel", wallEncoding.decode);
+		shader->setFloat("aLayer", (float)WALL_LAYER);
+	}
+
+	//Fragments shaded by the colour pass while showing overdraw, read back a frame or more later so the query never stalls
+	GLuint overdrawQuery;
+	glGenQueries(1, &overdrawQuery);
+	bool overdrawQueryPending = false;
+	float lastOverdrawReport = 0.0f;
+
+	// every element samples the same texture array, so it is bound once for the whole run
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray);
 
-	// tell opengl for each sampler to which texture unit it belongs to (only has to be done once)
-	ourShader.use();
-	ourShader.setInt("texture", 0);
+	// frame constants shared by every shader through one uniform buffer
+	GLuint frameUBO = createFrameBuffer();
+	FrameData frame;
 
 	// set lightning data for the shader
-	ourShader.setVec3("light.Direction", -5.f, -3.f, -1.f);
-	ourShader.setVec3("light.ambient", 1.f, 1.f, 1.f);
-	ourShader.setVec3("light.diffuse", 10.f, 10.f, 10.f);
-	ourShader.setVec3("light.specular", 15.0f, 15.0f, 15.0f);
+	frame.lightDirection = glm::vec4(-5.f, -3.f, -1.f, 0.f);
+	frame.lightAmbient = glm::vec4(1.f, 1.f, 1.f, 0.f);
+	frame.lightDiffuse = glm::vec4(10.f, 10.f, 10.f, 0.f);
+	frame.lightSpecular = glm::vec4(15.0f, 15.0f, 15.0f, 0.f);
 
-	// pass projection matrix to shader (as projection matrix rarely changes there's no need to do this per frame)
-	glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)WIDTH / (float)HEIGHT, 0.1f, 100.0f);
-	ourShader.setMat4("projection", projection);
+	// projection matrix rarely changes, but it rides along in the same upload as the view
+	frame.projection = glm::perspective(glm::radians(FIELD_OF_VIEW), (float)WIDTH / (float)HEIGHT, 0.1f, VIEW_DISTANCE);
 
 	//Input configuration && callback method
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 	glfwSetCursorPosCallback(window, mouseCallback);
+	glfwSetKeyCallback(window, keyCallback);
 
-	for (int i = 0; i < 4; i++) { ghostPos.push_back(glm::vec3(0, 0, 0)); } // Initialize ghost position vector
 	//Main game loop
+	size_t lastFrameAllocations = 0;
+	CullCounts lastCullCounts;
+	CullCounts gpuCullCounts; // Last counts read back from the GPU path
 	while(!glfwWindowShouldClose(window)){
+		size_t frameStartAllocations = allocationCount();
 
 		//##########################################################
 		// GAME LOGIC PORTION
 		//##########################################################
 		
-		//Deltatime calculation
+		//Frame time calculation, capped so a long hitch does not stall the game in catch-up ticks
 		float currentFrame = glfwGetTime();
-		deltaTime = currentFrame - lastFrame;
+		accumulator += min(currentFrame - lastFrame, MAX_FRAME_TIME);
 		lastFrame = currentFrame;
 
-		//moving lights
-		ourShader.setVec3("light.Direction", -1.f * (cos(currentFrame)/2), -2 * abs(sin((currentFrame/3))), -1.0f *(sin(currentFrame/2 + 0.5)));
-
-		//pellet logic
-		for (int i = 0; i < pellets.size(); i++) {
-			//If pellets withing pickup range of player: remove it from vector
-			if (glm::distance(pellets[i], player->getPosition()) < 0.5f) pellets.erase(pellets.begin()+i);
-		}
-		if (pellets.size() == 0) { //win condition
-			win = true;
-			cout << "YOU WIN!" << endl;
+		//Run as many fixed ticks as the elapsed time covers, so every AI decision still happens under load
+		while (accumulator >= SIMULATION_STEP) {
+			simulate(SIMULATION_STEP, pelletInstances, gpuCulling.get(), pelletBatch);
+			accumulator -= SIMULATION_STEP;
 		}
+		float alpha = accumulator / SIMULATION_STEP; // How far we are into the next tick
 
-		//ghost logic
-		for (int i = 0; i < ghosts.size(); i++) {
-			ghostPos[i] = ghosts[i]->updateGhost(deltaTime); //update ghosts Position and return it to position-array
-			if (glm::distance(ghostPos[i], player->getPosition()) < 1.0f) { //If current ghost within range of player, Game Over!
-				gameOver = true; 
-				cout << "YOU LOSE" << endl;
+		//moving lights
+		frame.lightDirection = glm::vec4(-1.f * (cos(currentFrame)/2), -2 * abs(sin((currentFrame/3))), -1.0f *(sin(currentFrame/2 + 0.5)), 0.f);
+
+		//everything outside the player's view frustum, or hidden behind the maze walls, is left out of this frame's draws
+		glm::vec3 camera = player->getPosition(alpha);
+		frame.view = player->generateView(alpha);
+		glm::mat4 viewProjection = frame.projection * frame.view;
+		Frustum frustum = extractFrustum(viewProjection);
+		CullCounts cullCounts;
+		if (GRID_VISIBILITY && !gpuCulling) {
+			if (!pvs || !applyPvs(pvs, levelGrid, camera, visibility)) {
+				castVisibility(levelGrid, viewProjection, camera, VIEW_DISTANCE, visibility);
 			}
+			cullCounts.cells = levelGrid.getSizeX() * levelGrid.getSizeZ();
+			cullCounts.cellsVisible = visibility.visibleCells;
 		}
 
-		//userInput
-		player->processInput(window, deltaTime);
+		int lodInstances[GHOST_LODS] = {};
+		int wallCommands = 0;
+		if (gpuCulling) {
+			//ghosts are uploaded in their own order, the compute shader groups the visible ones by level of detail
+			for (int i = 0; i < ghosts.size(); i++) {
+				ghostPos[i] = ghosts[i]->getPosition(alpha);
+				gpuCulling->updateSphere(ghostBatch, i, glm::vec4(ghostPos[i], GHOST_RADIUS));
+			}
+			updateInstances(ghostInstances, 0, ghostPos);
+
+			//the GPU's own commands are read back once they are done, so the report trails the view by a frame or so
+			if (gpuCulling->readBackCommands()) {
+				gpuCullCounts.wallChunks = wallChunkCount;
+				gpuCullCounts.wallChunksSubmitted = gpuCulling->commandsDrawn(wallBatch);
+				gpuCullCounts.pellets = pellets.size();
+				gpuCullCounts.pelletsSubmitted = gpuCulling->instancesDrawn(pelletBatch);
+				gpuCullCounts.ghosts = ghosts.size();
+				gpuCullCounts.ghostsSubmitted = gpuCulling->instancesDrawn(ghostBatch);
+			}
+			cullCounts = gpuCullCounts;
+			gpuCulling->cull(frustum, camera);
+		}
+		else {
+			//ghosts are drawn between their last two simulated positions, at a level of detail that fits their size on screen.
+			//Visible instances are grouped by level so each level is a single draw.
+			for (int i = 0; i < ghosts.size(); i++) {
+				glm::vec3 position = ghosts[i]->getPosition(alpha);
+				bool visible = sphereVisible(frustum, position, GHOST_RADIUS)
+					&& (!GRID_VISIBILITY || sphereCellsVisible(levelGrid, visibility, position, GHOST_FOOTPRINT));
+				ghostLod[i] = visible ? selectLod(position, GHOST_RADIUS, camera, ghostLods.size()) : -1;
+				if (ghostLod[i] >= 0) lodInstances[ghostLod[i]]++;
+			}
+			int lodSlot[GHOST_LODS] = {};
+			for (int lod = 1; lod < GHOST_LODS; lod++) {
+				lodSlot[lod] = lodSlot[lod - 1] + lodInstances[lod - 1];
+			}
+			for (int i = 0; i < ghosts.size(); i++) {
+				if (ghostLod[i] >= 0) ghostPos[lodSlot[ghostLod[i]]++] = ghosts[i]->getPosition(alpha);
+			}
+			cullCounts.ghosts = ghosts.size();
+			cullCounts.ghostsSubmitted = lodSlot[GHOST_LODS - 1];
+			updateInstances(ghostInstances, 0, PositionView(ghostPos.data(), cullCounts.ghostsSubmitted));
+
+			//walls and pellets are culled per level chunk, four chunk boxes per test, then by the chunks the line of sight reached
+			cullBoxes(frustum, chunkBounds, chunkVisible);
+			if (GRID_VISIBILITY) {
+				for (int i = 0; i < levelChunks.size(); i++) {
+					chunkVisible[i] &= visibility.chunkFrames[i] == visibility.frame;
+				}
+			}
+			sortChunksFrontToBack(camera, chunkOrder, chunkBuckets);
+			writeChunkCommands(levelChunks, chunkOrder, chunkVisible, pelletSize, drawCommands, wallCommands, cullCounts);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+			glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(DrawElementsIndirectCommand) * drawCommands.size(), drawCommands.data());
+		}
 
 		//##########################################################
 		// DRAW PORTION
@@ -130,49 +366,252 @@ int main() {
 		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		// activate shader and apply player view
-		ourShader.use();
-		ourShader.setMat4("view", player->generateView());
-
-		// give camera position for specular light calculation
-		ourShader.setVec3("CameraPosition", player->getPosition());
+		// apply camera position (for specular light calculation), then upload all frame constants at once
+		frame.cameraPosition = glm::vec4(camera, 1.f);
+		updateFrameBuffer(frameUBO, frame);
 		
-		//Draw walls, pellets and ghosts
-		drawElements(level, wallTexture, wallVAO, 1.0f , 36, ourShader);
-		drawElements(pellets, pelletTexture, pelletVAO, 0.3f, pelletSize, ourShader);
-		drawElements(ghostPos, ghostTexture, ghostVAO, 0.75f, ghostSize, ourShader);
+		//Draw walls, pellets and ghosts. Walls go first as the largest occluders, their chunks nearest first,
+		//so later fragments behind them fail the depth test before they are shaded.
+		auto drawOpaque = [&](Shader& wall, Shader& pellet, Shader& ghost) {
+			if (gpuCulling) {
+				gpuCulling->draw(wallBatch, wallVAO, wall);
+				gpuCulling->draw(pelletBatch, pelletVAO, pellet);
+				gpuCulling->draw(ghostBatch, ghostVAO, ghost);
+			}
+			else {
+				drawIndirect(wallVAO, 0, wallCommands, wall);
+				drawIndirect(pelletVAO, wallCommands, drawCommands.size() - wallCommands, pellet);
+				drawLods(lodInstances, ghostVAO, ghostLods, ghost);
+			}
+		};
+		if (depthPrepass) {
+			//depth only, then the lit pass shades just the nearest fragment of every pixel
+			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			drawOpaque(wallDepthShader, pelletDepthShader, ghostDepthShader);
+			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+			glDepthFunc(GL_LEQUAL);
+			glDepthMask(GL_FALSE);
+		}
+		bool countOverdraw = showOverdraw && !overdrawQueryPending;
+		if (countOverdraw) glBeginQuery(GL_SAMPLES_PASSED, overdrawQuery);
+		if (showOverdraw) {
+			glEnable(GL_BLEND);
+			glBlendFunc(GL_ONE, GL_ONE);
+			drawOpaque(wallOverdrawShader, pelletOverdrawShader, ghostOverdrawShader);
+			glDisable(GL_BLEND);
+		}
+		else {
+			drawOpaque(wallShader, pelletShader, ghostShader);
+		}
+		if (countOverdraw) {
+			glEndQuery(GL_SAMPLES_PASSED);
+			overdrawQueryPending = true;
+		}
+		glDepthFunc(GL_LESS);
+		glDepthMask(GL_TRUE); // also needed for next frame's depth clear
+		if (gpuCulling) gpuCulling->buildHiZ(viewProjection); // occluders for next frame's culling
 
 		glfwSwapBuffers(window);
 		glfwPollEvents();
+
+		//Steady-state frames should not touch the heap, report whenever that changes
+		size_t frameAllocations = allocationCount() - frameStartAllocations;
+		if (frameAllocations != lastFrameAllocations) {
+			cout << "Heap allocations per frame: " << frameAllocations << endl;
+			lastFrameAllocations = frameAllocations;
+		}
+		if (overdrawQueryPending) {
+			GLuint available = 0;
+			glGetQueryObjectuiv(overdrawQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available) {
+				GLuint samples = 0;
+				glGetQueryObjectuiv(overdrawQuery, GL_QUERY_RESULT, &samples);
+				overdrawQueryPending = false;
+				if (currentFrame - lastOverdrawReport >= 1.0f) {
+					cout << "Overdraw: " << (float)samples / (framebufferWidth * framebufferHeight) << " fragments shaded per pixel, depth pre-pass "
+						<< (depthPrepass ? "on" : "off") << endl;
+					lastOverdrawReport = currentFrame;
+				}
+			}
+		}
+		if (cullCounts != lastCullCounts) {
+			cout << "Submitted after culling: " << cullCounts.cellsVisible << "/" << cullCounts.cells << " cells visible, "
+				<< cullCounts.wallChunksSubmitted << "/" << cullCounts.wallChunks << " wall chunks, "
+				<< cullCounts.pelletsSubmitted << "/" << cullCounts.pellets << " pellets, "
+				<< cullCounts.ghostsSubmitted << "/" << cullCounts.ghosts << " ghosts" << endl;
+			lastCullCounts = cullCounts;
+		}
 	}
 
 	//Termination of Stuff 
+	gpuCulling.reset();
 	cleanVAO(ghostVAO);
 	cleanVAO(pelletVAO);
 	cleanVAO(wallVAO);
+	glDeleteTextures(1, &textureArray);
+	glDeleteBuffers(1, &frameUBO);
+	glDeleteBuffers(1, &indirectBuffer);
+	glDeleteQueries(1, &overdrawQuery);
 	glfwTerminate();
 }
 
 /// <summary>
-/// Draws a VAO at an array of positions, with texture and scale
+/// Advances the game by one fixed simulation tick
+/// </summary>
+/// <param name="dt">Length of the tick</param>
+/// <param name="pelletInstances">Instance buffer eaten pellets are removed from</param>
+/// <param name="gpuCulling">GPU culling whose pellet objects follow the instance buffer, nullptr when culling on the CPU</param>
+/// <param name="pelletBatch">Pellet batch of gpuCulling</param>
+void simulate(float dt, InstanceBuffer& pelletInstances, GpuCulling* gpuCulling, int pelletBatch) {
+	//pellet logic
+	//If pellets withing pickup range of player: remove it, the last live pellet of its chunk takes its slot in the instance buffer as well
+	int eaten, moved;
+	while ((eaten = pellets.pickup(player->getPosition(), 0.5f, moved)) >= 0) {
+		if (moved >= 0) copyInstance(pelletInstances, moved, eaten);
+		if (gpuCulling) {
+			//the pellet's object follows it, the slot left empty at the end of the chunk is taken out of culling
+			if (moved >= 0) gpuCulling->updateSphere(pelletBatch, eaten, glm::vec4(pellets[eaten], PELLET_RADIUS));
+			gpuCulling->updateSphere(pelletBatch, moved >= 0 ? moved : eaten, glm::vec4(0.0f));
+		}
+	}
+	if (pellets.empty()) { //win condition
+		win = true;
+		cout << "YOU WIN!" << endl;
+	}
+
+	//ghost logic
+	for (int i = 0; i < ghosts.size(); i++) {
+		glm::vec3 ghost = ghosts[i]->updateGhost(dt); //update ghosts Position
+		if (glm::distance(ghost, player->getPosition()) < 1.0f) { //If current ghost within range of player, Game Over!
+			gameOver = true;
+			cout << "YOU LOSE" << endl;
+		}
+	}
+
+	//userInput
+	player->processInput(window, dt);
+}
+
+/// <summary>
+/// Orders the level chunks front to back with a counting sort on their distance, in whole chunks, from the chunk the camera is in.
+/// Chunks in the same ring around the camera are close enough in depth that their order among each other does not matter.
+/// </summary>
+/// <param name="camera">Camera position</param>
+/// <param name="order">Every chunk index, nearest first, filled by the function</param>
+/// <param name="bucketStarts">Scratch space for the counting sort, one entry per distance</param>
+void sortChunksFrontToBack(glm::vec3 camera, vector<int>& order, vector<int>& bucketStarts) {
+	int chunksX = levelGrid.getChunksX(), chunksZ = levelGrid.getChunksZ();
+	int cameraX = min(max((int)round(camera.x), 0), levelGrid.getSizeX() - 1) / LEVEL_CHUNK_SIZE;
+	int cameraZ = min(max((int)round(camera.z), 0), levelGrid.getSizeZ() - 1) / LEVEL_CHUNK_SIZE;
+	auto distance = [&](int chunk) { return max(abs(chunk % chunksX - cameraX), abs(chunk / chunksX - cameraZ)); };
+
+	//Count the chunks at every distance, turn the counts into where each distance starts, then place the chunks
+	bucketStarts.assign(max(chunksX, chunksZ) + 1, 0);
+	for (int chunk = 0; chunk < chunksX * chunksZ; chunk++) {
+		bucketStarts[distance(chunk) + 1]++;
+	}
+	for (int bucket = 1; bucket < bucketStarts.size(); bucket++) {
+		bucketStarts[bucket] += bucketStarts[bucket - 1];
+	}
+	for (int chunk = 0; chunk < chunksX * chunksZ; chunk++) {
+		order[bucketStarts[distance(chunk)]++] = chunk;
+	}
+}
+
+/// <summary>
+/// Writes the draw stream for the level chunks that passed the frustum test: the wall commands first, one per chunk with walls,
+/// then the pellet commands, one per chunk with pellets left, each drawing that chunk's range of the instance buffer.
+/// Both follow the given chunk order, so a multi-draw reaches the near chunks first.
+/// </summary>
+/// <param name="chunks">Level chunks</param>
+/// <param name="order">Order to write the chunks in, see sortChunksFrontToBack</param>
+/// <param name="visible">Frustum test result of every chunk</param>
+/// <param name="pelletSize">Number of indices in the pellet VAO</param>
+/// <param name="commands">Draw stream, cleared and filled by the function within its reserved capacity</param>
+/// <param name="wallCommands">Number of wall commands at the start of the stream</param>
+/// <param name="counts">Wall and pellet counts, filled by the function</param>
+void writeChunkCommands(const vector<LevelChunk>& chunks, const vector<int>& order, const vector<uint8_t>& visible, int pelletSize,
+	vector<DrawElementsIndirectCommand>& commands, int& wallCommands, CullCounts& counts) {
+	commands.clear();
+	for (int i : order) {
+		if (chunks[i].indexCount == 0) continue;
+		counts.wallChunks++;
+		if (!visible[i]) continue;
+		commands.push_back({ chunks[i].indexCount, 1, chunks[i].firstIndex, 0, 0 });
+	}
+	wallCommands = commands.size();
+	counts.wallChunksSubmitted = wallCommands;
+
+	const vector<PelletChunk>& pelletChunks = pellets.getChunks();
+	for (int i : order) {
+		if (pelletChunks[i].count == 0) continue;
+		counts.pellets += pelletChunks[i].count;
+		if (!visible[i]) continue;
+		commands.push_back({ (GLuint)pelletSize, (GLuint)pelletChunks[i].count, 0, 0, (GLuint)pelletChunks[i].first });
+		counts.pelletsSubmitted += pelletChunks[i].count;
+	}
+}
+
+/// <summary>
+/// Draws a run of commands from the indirect buffer with a single call.
+/// Textures come from the shared texture array through each instance's layer, so only the VAO and shader variant change between draws.
 /// </summary>
-/// <param name="elements">Positions to draw VAOs at</param>
-/// <param name="texture">Texture applied to VAOs</param>
 /// <param name="VAO">VAO to draw</param>
-/// <param name="scale">Scale to draw VAOs in</param>
-/// <param name="vectorSize">Number of vertices in VAO</param>
-/// <param name="mainShader">ShaderProgram</param>
-void drawElements(vector<glm::vec3> elements, unsigned int texture, GLuint VAO, float scale, int vectorSize, Shader shader) {
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, texture);
+/// <param name="firstCommand">First command in the bound GL_DRAW_INDIRECT_BUFFER</param>
+/// <param name="commandCount">Number of commands to draw</param>
+/// <param name="shader">ShaderProgram variant to draw with</param>
+void drawIndirect(GLuint VAO, int firstCommand, int commandCount, Shader& shader) {
+	if (commandCount == 0) return;
+	shader.use();
+	glBindVertexArray(VAO);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(sizeof(DrawElementsIndirectCommand) * firstCommand), commandCount, 0);
+}
+
+/// <summary>
+/// Draws instances grouped by level of detail, one instanced draw per level that has any.
+/// Every level reads its own index range of the shared element buffer and its own range of the instance buffer.
+/// </summary>
+/// <param name="lodInstances">Number of instances per level, stored one level after the other in the instance buffer</param>
+/// <param name="VAO">VAO to draw</param>
+/// <param name="lods">Index range of every level</param>
+/// <param name="shader">ShaderProgram variant to draw with</param>
+void drawLods(const int* lodInstances, GLuint VAO, const vector<MeshLod>& lods, Shader& shader) {
+	shader.use();
 	glBindVertexArray(VAO);
-	for (int i = 0; i < elements.size(); i++) {
-		glm::mat4 model = glm::mat4(1.0f);
-		model = glm::translate(model, elements[i]);
-		model = glm::scale(model, glm::vec3(scale, scale, scale));
-		shader.setMat4("model", model);
-		glDrawArrays(GL_TRIANGLES, 0, vectorSize);
+	int baseInstance = 0;
+	for (int lod = 0; lod < lods.size(); lod++) {
+		if (lodInstances[lod] == 0) continue;
+		glDrawElementsInstancedBaseInstance(GL_TRIANGLES, lods[lod].indexCount, GL_UNSIGNED_INT,
+			(void*)(sizeof(GLuint) * lods[lod].firstIndex), lodInstances[lod], baseInstance);
+		baseInstance += lodInstances[lod];
+	}
+}
+
+/// <summary>
+/// Picks a level of detail from the height of an object's bounding sphere on screen
+/// </summary>
+/// <param name="position">Object position</param>
+/// <param name="radius">Bounding sphere radius</param>
+/// <param name="camera">Camera position</param>
+/// <param name="lodCount">Number of levels available</param>
+/// <returns>0 for full detail, one level coarser for every halving below LOD_FULL_DETAIL_PIXELS</returns>
+int selectLod(glm::vec3 position, float radius, glm::vec3 camera, int lodCount) {
+	float distance = max(glm::distance(position, camera), radius);
+	float pixels = radius * HEIGHT / (distance * tan(glm::radians(FIELD_OF_VIEW) / 2));
+	int lod = 0;
+	while (lod < lodCount - 1 && pixels < LOD_FULL_DETAIL_PIXELS / (float)(1 << lod)) {
+		lod++;
 	}
+	return lod;
+}
+
+/// <summary>
+/// Shader features a mesh's vertex layout needs
+/// </summary>
+/// <param name="encoding">Layout the mesh was uploaded with</param>
+/// <returns>SHADER_PACKED_VERTICES for packed meshes, otherwise no features</returns>
+unsigned int vertexFeatures(const MeshEncoding& encoding) {
+	return encoding.format == VERTEX_PACKED ? (unsigned int)SHADER_PACKED_VERTICES : 0u;
 }
 
 //Calls the same function in Player class as i couldnt apply the class function directly
@@ -182,36 +621,24 @@ void mouseCallback(GLFWwindow* window, double xpos, double ypos)
 }
 
 /// <summary>
-/// Loads texture from path and returns it
+/// Render toggles: O switches the overdraw visualisation, P the depth pre-pass
 /// </summary>
-/// <param name="path"> path to texture</param>
-/// <returns>texture</returns>
-unsigned int initializeTexture(string path) {
-	unsigned int texture;
-
-	glGenTextures(1, &texture);
-	glBindTexture(GL_TEXTURE_2D, texture);
-	// set the texture wrapping parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	// set texture filtering parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	// load image, create texture and generate mipmaps
-	int width, height, nrChannels;
-	//stbi_set_flip_vertically_on_load(true); // tell stb_image.h to flip loaded texture's on the y-axis.
-	unsigned char* data = stbi_load(FileSystem::getPath(path).c_str(), &width, &height, &nrChannels, 0);
-	if (data)
-	{
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
+/// <param name="window">Window the key was pressed in</param>
+/// <param name="key">GLFW key code</param>
+/// <param name="scancode">Platform scancode</param>
+/// <param name="action">GLFW_PRESS, GLFW_RELEASE or GLFW_REPEAT</param>
+/// <param name="mods">Modifier keys held</param>
+void keyCallback(GLFWwindow* /*window*/, int key, int /*scancode*/, int action, int /*mods*/)
+{
+	if (action != GLFW_PRESS) return;
+	if (key == GLFW_KEY_O) {
+		showOverdraw = !showOverdraw;
+		cout << "Overdraw visualisation " << (showOverdraw ? "on" : "off") << endl;
 	}
-	else
-	{
-		std::cout << "Failed to load texture from " << path << std::endl;
+	if (key == GLFW_KEY_P) {
+		depthPrepass = !depthPrepass;
+		cout << "Depth pre-pass " << (depthPrepass ? "on" : "off") << endl;
 	}
-	stbi_image_free(data);
-	return texture;
 }
 
 /// <summary>
@@ -266,19 +693,20 @@ int initialize() {
 /// </summary>
 /// <param name="path"></param>
 void readLevel(string path) {
-	ifstream lvlFile(path);
-	if (lvlFile)
+	Asset level(path);
+	AssetStreamBuffer levelBuffer(level);
+	istream lvlFile(&levelBuffer);
+	if (level.isOpen())
 	{
 		string size;
 		lvlFile >> size;
-		int xMax = stoi(size.substr(0, 2));
-		int yMax = stoi(size.substr(3));
+		size_t separator = size.find('x');
+		int xMax = stoi(size.substr(0, separator));
+		int yMax = stoi(size.substr(separator + 1));
 
-		//init 2D Vector
-		ghostLvl = vector<vector<int>>(xMax);
-		for (int i = 0; i < xMax; i++) {
-			ghostLvl[i] = vector<int>(yMax);
-		}
+		//Rows of the file run along x in world space
+		levelGrid = LevelGrid(yMax, xMax);
+		pellets.resize(yMax, xMax);
 
 		int data;
 
@@ -289,26 +717,28 @@ void readLevel(string path) {
 				lvlFile >> data;
 				switch (data) {
 				case 0:
-					pellets.push_back(glm::vec3(i, -0.25, j));
+					pellets.add(glm::vec3(i, -0.25, j));
 					break;
 				case 1:
-					level.push_back(glm::vec3(i, 0, j));
+					levelGrid.setWall(i, j, true);
 					break;
 				case 2:
 					player = new Player(glm::vec3(i, 0, j), WIDTH / 2, HEIGHT / 2);
 					break;
 				}
-				ghostLvl[j][i] = (data == 1) ? 1 : 0; // Build level for ghost AI
 			}
 		}
 
+		//Pellets of a chunk are culled and drawn as one instance range
+		pellets.groupByChunk(levelGrid);
+
 		//Generate ghost position
 		//RNG seeded by current time in seconds since January 1st, 1970
 		srand(time(NULL));
 		for (int i = 0; i < 4; i++) {
 			//Pellets contain all walkable space in map so a random pick from pellets will give a valid location
 			glm::vec3 pos = pellets[rand() % pellets.size()];
-			ghosts.push_back(new Ghost(ghostLvl, pos.z, pos.x));
+			ghosts.push_back(new Ghost(levelGrid, pos.z, pos.x));
 			
 			srand(rand()); //re-seed rng
 		}
@@ -316,5 +746,4 @@ void readLevel(string path) {
 	else {
 		cout << "\n --Unable to read file " << path;
 	}
-	lvlFile.close();
 }
\ No newline at end of file
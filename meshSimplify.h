@@ -0,0 +1,247 @@
+#ifndef meshSimplify_header
+#define meshSimplify_header
+
+#include <vector>
+#include <queue>
+#include <map>
+#include <tuple>
+#include <algorithm>
+#include <glad/glad.h>
+#include "glm/glm/glm.hpp"
+#include "vertex.h"
+
+using namespace std;
+
+//Index range of one level of detail inside a model's element buffer
+struct MeshLod
+{
+	GLuint firstIndex;
+	GLuint indexCount;
+};
+
+//Symmetric 4x4 error quadric, sum of squared distances to a set of planes
+struct Quadric
+{
+	double a[10] = {};
+
+	void addPlane(glm::dvec3 normal, double d, double weight) {
+		double p[4] = { normal.x, normal.y, normal.z, d };
+		int k = 0;
+		for (int i = 0; i < 4; i++) {
+			for (int j = i; j < 4; j++) {
+				a[k++] += p[i] * p[j] * weight;
+			}
+		}
+	}
+	void add(const Quadric& other) {
+		for (int i = 0; i < 10; i++) a[i] += other.a[i];
+	}
+	double error(glm::dvec3 v) const {
+		return a[0] * v.x * v.x + 2 * a[1] * v.x * v.y + 2 * a[2] * v.x * v.z + 2 * a[3] * v.x
+			+ a[4] * v.y * v.y + 2 * a[5] * v.y * v.z + 2 * a[6] * v.y
+			+ a[7] * v.z * v.z + 2 * a[8] * v.z
+			+ a[9];
+	}
+};
+
+//Candidate collapse of every corner at position group "from" onto position group "to"
+struct Collapse
+{
+	double cost;
+	int from, to;
+	unsigned int fromVersion, toVersion;
+
+	bool operator>(const Collapse& other) const { return cost > other.cost; }
+};
+
+void simplifyMesh(const vector<Vertex>& vertices, const vector<GLuint>& indices, size_t targetTriangles, vector<GLuint>& result);
+void generateLods(const vector<Vertex>& vertices, vector<GLuint>& indices, int lodCount, vector<MeshLod>& lods);
+
+/// <summary>
+/// Reduces a triangle mesh with quadric error metric edge collapses.
+/// Vertices sharing a position (UV or normal seams) are collapsed as one, and the collapse always moves onto an
+/// existing vertex, so the result indexes the original vertex array and every LOD can share one vertex buffer.
+/// </summary>
+/// <param name="vertices">Mesh vertices</param>
+/// <param name="indices">Triangle list to simplify</param>
+/// <param name="targetTriangles">Triangle count to stop at</param>
+/// <param name="result">Simplified triangle list, filled by the function</param>
+void simplifyMesh(const vector<Vertex>& vertices, const vector<GLuint>& indices, size_t targetTriangles, vector<GLuint>& result) {
+	//Weld vertices by position
+	map<tuple<float, float, float>, int> positionGroups;
+	vector<int> groupOf(vertices.size());
+	vector<glm::dvec3> positions;
+	vector<vector<GLuint>> groupVertices;
+	for (size_t i = 0; i < vertices.size(); i++) {
+		const glm::vec3& p = vertices[i].location;
+		auto found = positionGroups.emplace(make_tuple(p.x, p.y, p.z), (int)positions.size());
+		if (found.second) {
+			positions.push_back(glm::dvec3(p));
+			groupVertices.emplace_back();
+		}
+		groupOf[i] = found.first->second;
+		groupVertices[groupOf[i]].push_back(i);
+	}
+	size_t groupCount = positions.size();
+
+	vector<GLuint> corners = indices;
+	size_t triangleCount = corners.size() / 3;
+	vector<bool> triangleAlive(triangleCount, true);
+	vector<vector<int>> groupTriangles(groupCount);
+	vector<Quadric> quadrics(groupCount);
+	auto group = [&](size_t triangle, int corner) { return groupOf[corners[triangle * 3 + corner]]; };
+
+	//Every vertex starts with the planes of the triangles around it, weighted by area
+	map<pair<int, int>, int> edgeUse;
+	for (size_t t = 0; t < triangleCount; t++) {
+		int g[3] = { group(t, 0), group(t, 1), group(t, 2) };
+		glm::dvec3 cross = glm::cross(positions[g[1]] - positions[g[0]], positions[g[2]] - positions[g[0]]);
+		double area = glm::length(cross);
+		if (g[0] == g[1] || g[1] == g[2] || g[2] == g[0] || area == 0) {
+			triangleAlive[t] = false;
+			continue;
+		}
+		glm::dvec3 normal = cross / area;
+		for (int c = 0; c < 3; c++) {
+			quadrics[g[c]].addPlane(normal, -glm::dot(normal, positions[g[0]]), area);
+			groupTriangles[g[c]].push_back(t);
+			edgeUse[make_pair(min(g[c], g[(c + 1) % 3]), max(g[c], g[(c + 1) % 3]))]++;
+		}
+	}
+
+	//Open borders get a plane perpendicular to the surface so the outline does not shrink
+	for (size_t t = 0; t < triangleCount; t++) {
+		if (!triangleAlive[t]) continue;
+		int g[3] = { group(t, 0), group(t, 1), group(t, 2) };
+		glm::dvec3 normal = glm::normalize(glm::cross(positions[g[1]] - positions[g[0]], positions[g[2]] - positions[g[0]]));
+		for (int c = 0; c < 3; c++) {
+			int a = g[c], b = g[(c + 1) % 3];
+			if (edgeUse[make_pair(min(a, b), max(a, b))] != 1) continue;
+			glm::dvec3 edge = positions[b] - positions[a];
+			glm::dvec3 border = glm::normalize(glm::cross(edge, normal));
+			double weight = glm::dot(edge, edge) * 1000.0;
+			quadrics[a].addPlane(border, -glm::dot(border, positions[a]), weight);
+			quadrics[b].addPlane(border, -glm::dot(border, positions[a]), weight);
+		}
+	}
+
+	vector<unsigned int> versions(groupCount, 0);
+	vector<bool> groupAlive(groupCount, true);
+	priority_queue<Collapse, vector<Collapse>, greater<Collapse>> queue;
+	auto pushCollapse = [&](int from, int to) {
+		Quadric q = quadrics[from];
+		q.add(quadrics[to]);
+		queue.push({ q.error(positions[to]), from, to, versions[from], versions[to] });
+	};
+	for (auto& edge : edgeUse) {
+		pushCollapse(edge.first.first, edge.first.second);
+		pushCollapse(edge.first.second, edge.first.first);
+	}
+
+	size_t liveTriangles = count(triangleAlive.begin(), triangleAlive.end(), true);
+	while (liveTriangles > targetTriangles && !queue.empty()) {
+		Collapse collapse = queue.top();
+		queue.pop();
+		int from = collapse.from, to = collapse.to;
+		if (!groupAlive[from] || !groupAlive[to] || versions[from] != collapse.fromVersion || versions[to] != collapse.toVersion) continue;
+
+		//Reject collapses that would turn a remaining triangle over
+		bool flips = false;
+		for (int t : groupTriangles[from]) {
+			if (!triangleAlive[t]) continue;
+			int g[3] = { group(t, 0), group(t, 1), group(t, 2) };
+			if (g[0] == to || g[1] == to || g[2] == to) continue;
+			glm::dvec3 before = glm::cross(positions[g[1]] - positions[g[0]], positions[g[2]] - positions[g[0]]);
+			for (int c = 0; c < 3; c++) {
+				if (g[c] == from) g[c] = to;
+			}
+			glm::dvec3 after = glm::cross(positions[g[1]] - positions[g[0]], positions[g[2]] - positions[g[0]]);
+			if (glm::dot(before, after) <= 0) {
+				flips = true;
+				break;
+			}
+		}
+		if (flips) continue;
+
+		//Move every corner onto the vertex of the target position whose normal matches it best, keeping seams apart
+		for (int t : groupTriangles[from]) {
+			if (!triangleAlive[t]) continue;
+			bool degenerate = false;
+			for (int c = 0; c < 3; c++) {
+				if (group(t, c) == to) degenerate = true;
+			}
+			if (degenerate) {
+				triangleAlive[t] = false;
+				liveTriangles--;
+				continue;
+			}
+			for (int c = 0; c < 3; c++) {
+				GLuint& corner = corners[t * 3 + c];
+				if (groupOf[corner] != from) continue;
+				GLuint best = groupVertices[to][0];
+				float bestMatch = -2.0f;
+				for (GLuint candidate : groupVertices[to]) {
+					float match = glm::dot(vertices[candidate].normals, vertices[corner].normals);
+					if (match > bestMatch) {
+						bestMatch = match;
+						best = candidate;
+					}
+				}
+				corner = best;
+			}
+			groupTriangles[to].push_back(t);
+		}
+
+		groupAlive[from] = false;
+		quadrics[to].add(quadrics[from]);
+		versions[to]++;
+
+		//Drop dead triangles from the survivor and requeue its edges with the merged quadric
+		vector<int>& around = groupTriangles[to];
+		around.erase(remove_if(around.begin(), around.end(), [&](int t) { return !triangleAlive[t]; }), around.end());
+		sort(around.begin(), around.end());
+		around.erase(unique(around.begin(), around.end()), around.end());
+		vector<int> neighbours;
+		for (int t : around) {
+			for (int c = 0; c < 3; c++) {
+				if (group(t, c) != to) neighbours.push_back(group(t, c));
+			}
+		}
+		sort(neighbours.begin(), neighbours.end());
+		neighbours.erase(unique(neighbours.begin(), neighbours.end()), neighbours.end());
+		for (int neighbour : neighbours) {
+			pushCollapse(to, neighbour);
+			pushCollapse(neighbour, to);
+		}
+	}
+
+	result.clear();
+	for (size_t t = 0; t < triangleCount; t++) {
+		if (!triangleAlive[t]) continue;
+		result.insert(result.end(), corners.begin() + t * 3, corners.begin() + t * 3 + 3);
+	}
+}
+
+/// <summary>
+/// Builds a chain of levels of detail, each with half the triangles of the one before, and appends them to the index list
+/// </summary>
+/// <param name="vertices">Mesh vertices, shared by every level</param>
+/// <param name="indices">Full detail triangle list, the simplified levels are appended after it</param>
+/// <param name="lodCount">Number of levels including full detail</param>
+/// <param name="lods">Index range of every level, filled by the function</param>
+void generateLods(const vector<Vertex>& vertices, vector<GLuint>& indices, int lodCount, vector<MeshLod>& lods) {
+	lods.clear();
+	lods.push_back({ 0, (GLuint)indices.size() });
+
+	vector<GLuint> previous = indices, simplified;
+	for (int level = 1; level < lodCount; level++) {
+		simplifyMesh(vertices, previous, previous.size() / 6, simplified);
+		if (simplified.size() >= previous.size()) break; //Nothing left to collapse
+
+		lods.push_back({ (GLuint)indices.size(), (GLuint)simplified.size() });
+		indices.insert(indices.end(), simplified.begin(), simplified.end());
+		previous.swap(simplified);
+	}
+}
+
+#endif
@@ -0,0 +1,128 @@
+#include"pellets.h"
+
+#include <cmath>
+#include <algorithm>
+
+/// <summary>
+/// Clears all pellets and sets the size of the grid they are indexed by
+/// </summary>
+/// <param name="_sizeX">Number of cells along x</param>
+/// <param name="_sizeZ">Number of cells along z</param>
+void Pellets::resize(int _sizeX, int _sizeZ) {
+	sizeX = _sizeX;
+	sizeZ = _sizeZ;
+	positions.clear();
+	slotChunk.clear();
+	chunks.clear();
+	live = 0;
+	cells.assign(sizeX * sizeZ, -1);
+}
+
+/// <summary>
+/// Grid cell of a position, row-major along z
+/// </summary>
+/// <param name="x">x cell</param>
+/// <param name="z">z cell</param>
+/// <returns>Cell index or -1 if outside the grid</returns>
+int Pellets::cellOf(int x, int z) const {
+	if (x < 0 || x >= sizeX || z < 0 || z >= sizeZ) return -1;
+	return z * sizeX + x;
+}
+
+/// <summary>
+/// Places a pellet on the grid cell at its position
+/// </summary>
+/// <param name="position">Pellet position, x and z on integer cells</param>
+void Pellets::add(glm::vec3 position) {
+	int cell = cellOf((int)position.x, (int)position.z);
+	if (cell < 0) return;
+	cells[cell] = positions.size();
+	positions.push_back(position);
+	live++;
+}
+
+/// <summary>
+/// Reorders the pellets so every level chunk owns one contiguous range of slots, letting the renderer
+/// draw or skip a chunk's pellets as one instance range. Called once the level is read, before the instance buffer is made.
+/// </summary>
+/// <param name="grid">Level grid the chunks are taken from</param>
+void Pellets::groupByChunk(const LevelGrid& grid) {
+	auto chunkOf = [&](const glm::vec3& position) { return grid.chunkOf((int)position.x, (int)position.z); };
+	stable_sort(positions.begin(), positions.end(), [&](const glm::vec3& a, const glm::vec3& b) { return chunkOf(a) < chunkOf(b); });
+
+	chunks.assign(grid.getChunksX() * grid.getChunksZ(), { 0, 0 });
+	slotChunk.resize(positions.size());
+	for (int i = 0; i < positions.size(); i++) {
+		int chunk = chunkOf(positions[i]);
+		if (chunks[chunk].count == 0) chunks[chunk].first = i;
+		chunks[chunk].count++;
+		slotChunk[i] = chunk;
+		cells[cellOf((int)positions[i].x, (int)positions[i].z)] = i;
+	}
+}
+
+/// <summary>
+/// Removes one pellet within range of a position.
+/// Only the cells the range can reach are checked, and the last live pellet of the same chunk is swapped into the
+/// removed one's slot, so the pickup cost does not grow with the number of pellets and chunks stay contiguous.
+/// </summary>
+/// <param name="position">Position to pick up from</param>
+/// <param name="range">Pickup distance</param>
+/// <param name="moved">Slot whose pellet was moved into the returned one, -1 if nothing moved</param>
+/// <returns>Index of the removed pellet or -1 if none was in range</returns>
+int Pellets::pickup(glm::vec3 position, float range, int& moved) {
+	for (int z = (int)ceil(position.z - range); z <= (int)floor(position.z + range); z++) {
+		for (int x = (int)ceil(position.x - range); x <= (int)floor(position.x + range); x++) {
+			int cell = cellOf(x, z);
+			if (cell < 0 || cells[cell] < 0) continue;
+
+			int index = cells[cell];
+			if (glm::distance(positions[index], position) < range) {
+				moved = remove(index);
+				return index;
+			}
+		}
+	}
+	moved = -1;
+	return -1;
+}
+
+/// <summary>
+/// Swap-and-pop removal within the pellet's chunk, keeping the cell index of the moved pellet up to date
+/// </summary>
+/// <param name="index">Pellet to remove</param>
+/// <returns>Slot of the pellet moved into index, -1 if the removed pellet was the chunk's last</returns>
+int Pellets::remove(int index) {
+	PelletChunk& chunk = chunks[slotChunk[index]];
+	int last = chunk.first + chunk.count - 1;
+	glm::vec3 removed = positions[index];
+
+	cells[cellOf((int)removed.x, (int)removed.z)] = -1;
+	chunk.count--;
+	live--;
+	if (index == last) return -1;
+
+	positions[index] = positions[last];
+	cells[cellOf((int)positions[index].x, (int)positions[index].z)] = index;
+	return last;
+}
+
+const std::vector<glm::vec3>& Pellets::getPositions() const {
+	return positions;
+}
+
+const std::vector<PelletChunk>& Pellets::getChunks() const {
+	return chunks;
+}
+
+const glm::vec3& Pellets::operator[](int index) const {
+	return positions[index];
+}
+
+int Pellets::size() const {
+	return live;
+}
+
+bool Pellets::empty() const {
+	return live == 0;
+}
@@ -0,0 +1,43 @@
+#ifndef Pellets_header
+#define Pellets_header
+
+#include <vector>
+#include "glm/glm/glm.hpp"
+#include "levelGrid.h"
+
+using namespace std;
+
+//Instance range of the pellets in one level chunk, the live ones at the front
+struct PelletChunk
+{
+    int first;
+    int count;
+};
+
+class Pellets {
+private:
+    //Variables
+    std::vector<glm::vec3> positions; //Pellet slots grouped by chunk, in the same order as their instance buffer
+    std::vector<int> cells;           //Index into positions for every grid cell, -1 if empty
+    std::vector<int> slotChunk;       //Chunk every slot belongs to
+    std::vector<PelletChunk> chunks;  //In LevelGrid::chunkOf order
+    int sizeX = 0;
+    int sizeZ = 0;
+    int live = 0;
+
+    //Functions
+    int cellOf(int x, int z) const;
+    int remove(int index);
+public:
+    void resize(int _sizeX, int _sizeZ);
+    void add(glm::vec3 position);
+    void groupByChunk(const LevelGrid& grid);
+    int pickup(glm::vec3 position, float range, int& moved);
+    const std::vector<glm::vec3>& getPositions() const;
+    const std::vector<PelletChunk>& getChunks() const;
+    const glm::vec3& operator[](int index) const;
+    int size() const;
+    bool empty() const;
+};
+
+#endif
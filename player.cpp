@@ -1,12 +1,14 @@
 #include"player.h"
 
-extern vector<glm::vec3> level;
+#include "levelGrid.h"
+
+extern LevelGrid levelGrid;
 extern bool gameOver;
 extern bool win;
 
 Player::Player(glm::vec3 position, float _lastX, float _lastY) {
 	pitch = 0;
-	cameraPos = position;
+	previousPos = cameraPos = position;
 	lastX = _lastX, lastY = _lastY;
 }
 
@@ -14,7 +16,10 @@ Player::Player(glm::vec3 position, float _lastX, float _lastY) {
 /// Takes in all legal input from player and handles it.
 /// </summary>
 /// <param name="window">Window to get input data from</param>
+/// <param name="deltaTime">Length of one simulation tick</param>
 void Player::processInput(GLFWwindow* window, float deltaTime) {
+	previousPos = cameraPos;
+
 	//Close window
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, true);
@@ -104,7 +109,8 @@ void Player::movePlayer(glm::vec3 input) {
 }
 
 /// <summary>
-/// Checks a new position against all wall segments
+/// Checks a new position against the wall segments around it
+/// Only the grid cells the player's box can overlap are looked up, so the cost does not grow with the level
 /// Returns true if collision, false if no collision
 /// </summary>
 /// <param name="pos">Proposed new position</param>
@@ -113,27 +119,46 @@ bool Player::collides(glm::vec3 pos) {
 	bool xColl, zColl;
 	float size = 0.75;
 
-	for (int i = 0; i < level.size(); i++) {
-		glm::vec3 wall = level[i];
+	//Walls sit on integer cells, so only cells within size of pos can overlap
+	int minX = (int)floor(pos.x - size), maxX = (int)ceil(pos.x + size);
+	int minZ = (int)floor(pos.z - size), maxZ = (int)ceil(pos.z + size);
 
-		xColl = wall.x + size >= pos.x && wall.x - size <= pos.x; //X-axis overlap
-		zColl = wall.z + size >= pos.z && wall.z - size <= pos.z; //Y-axis overlap
+	for (int z = minZ; z <= maxZ; z++) {
+		for (int x = minX; x <= maxX; x++) {
+			if (!levelGrid.isWall(x, z)) continue;
+			glm::vec3 wall = glm::vec3(x, 0, z);
 
-		if (xColl && zColl) { // both overlap :: collision
-			return true;
+			xColl = wall.x + size >= pos.x && wall.x - size <= pos.x; //X-axis overlap
+			zColl = wall.z + size >= pos.z && wall.z - size <= pos.z; //Y-axis overlap
+
+			if (xColl && zColl) { // both overlap :: collision
+				return true;
+			}
 		}
 	}
 	return false;
 }
 
-glm::mat4 Player::generateView() {
+/// <summary>
+/// View matrix from the interpolated camera position
+/// </summary>
+/// <param name="alpha">How far the renderer is into the next tick, 0 to 1</param>
+/// <returns>View matrix</returns>
+glm::mat4 Player::generateView(float alpha) {
 	glm::mat4 view = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
 	if (!win && !gameOver) {
-		view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+		glm::vec3 position = getPosition(alpha);
+		view = glm::lookAt(position, position + cameraFront, cameraUp);
 	}
 	return view;
 }
 
+//Position as of the last simulation tick, used by game logic
 glm::vec3 Player::getPosition() {
 	return cameraPos;
+}
+
+//Position between the previous and the last simulation tick, used for rendering
+glm::vec3 Player::getPosition(float alpha) {
+	return glm::mix(previousPos, cameraPos, alpha);
 }
\ No newline at end of file
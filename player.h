@@ -12,6 +12,7 @@ class Player{
 private:
 	//Camera variables
 	glm::vec3 cameraPos = glm::vec3(0.0f, 0.0f, 0.0f);
+	glm::vec3 previousPos = glm::vec3(0.0f, 0.0f, 0.0f); //cameraPos at the start of the current tick
 	glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
 	glm::vec3 cameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
 	float yaw = -90.0f;
@@ -25,7 +26,8 @@ public:
 	Player(glm::vec3 pos, float _lastX, float _lastY);
 	void processInput(GLFWwindow* window, float deltaTime);
 	void mouseCallback(GLFWwindow* window, double xpos, double ypos);
-	glm::mat4 Player::generateView();
+	glm::mat4 Player::generateView(float alpha);
 	glm::vec3 Player::getPosition();
+	glm::vec3 Player::getPosition(float alpha);
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include"shaderVariants.h"
+
+#include <iostream>
+
+/// <summary>
+/// Sets up a family of shader variants. Nothing is compiled until a variant is requested.
+/// </summary>
+/// <param name="_vertexPath">Vertex shader source</param>
+/// <param name="_fragmentPath">Fragment shader source</param>
+/// <param name="_setup">Called with every newly compiled variant, while it is in use</param>
+ShaderVariants::ShaderVariants(const string& _vertexPath, const string& _fragmentPath, function<void(Shader&)> _setup)
+	: vertexPath(_vertexPath), fragmentPath(_fragmentPath), setup(_setup) {}
+
+/// <summary>
+/// Returns the variant for a feature set, compiling and caching it on first use.
+/// References stay valid for the lifetime of this object.
+/// </summary>
+/// <param name="features">Combination of ShaderFeature flags</param>
+/// <returns>Shader program with exactly those features</returns>
+Shader& ShaderVariants::get(unsigned int features) {
+	auto found = variants.find(features);
+	if (found != variants.end()) return *found->second;
+
+	unique_ptr<Shader> shader(new Shader(vertexPath.c_str(), fragmentPath.c_str(), nullptr, defines(features)));
+	if (setup) {
+		shader->use();
+		setup(*shader);
+	}
+	cout << "Compiled shader variant " << features << " of " << fragmentPath << endl;
+
+	Shader& variant = *shader;
+	variants[features] = move(shader);
+	return variant;
+}
+
+/// <summary>
+/// Number of variants compiled so far
+/// </summary>
+/// <returns>Variant count</returns>
+size_t ShaderVariants::size() const {
+	return variants.size();
+}
+
+/// <summary>
+/// Turns a feature set into the #define lines inserted into the sources
+/// </summary>
+/// <param name="features">Combination of ShaderFeature flags</param>
+/// <returns>Define block</returns>
+string ShaderVariants::defines(unsigned int features) {
+	string block;
+	if (features & SHADER_SPECULAR) block += "#define USE_SPECULAR\n";
+	if (features & SHADER_TEXTURE) block += "#define USE_TEXTURE\n";
+	if (features & SHADER_INSTANCING) block += "#define USE_INSTANCING\n";
+	if (features & SHADER_PACKED_VERTICES) block += "#define USE_PACKED_VERTICES\n";
+	if (features & SHADER_DEPTH_ONLY) block += "#define USE_DEPTH_ONLY\n";
+	if (features & SHADER_OVERDRAW) block += "#define USE_OVERDRAW\n";
+	return block;
+}
@@ -0,0 +1,39 @@
+#ifndef ShaderVariants_header
+#define ShaderVariants_header
+
+#include <string>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include "learnopengl/shader_m.h"
+
+using namespace std;
+
+//Feature flags, each one turns into a #define in the shader sources
+enum ShaderFeature : unsigned int {
+    SHADER_SPECULAR = 1 << 0,   //USE_SPECULAR, specular highlights
+    SHADER_TEXTURE = 1 << 1,    //USE_TEXTURE, sample the texture array instead of a flat baseColor
+    SHADER_INSTANCING = 1 << 2, //USE_INSTANCING, model matrix and layer from the instance buffer instead of uniforms
+    SHADER_PACKED_VERTICES = 1 << 3, //USE_PACKED_VERTICES, octahedral normals from a PackedVertex mesh
+    SHADER_DEPTH_ONLY = 1 << 4, //USE_DEPTH_ONLY, no shading at all, for the depth pre-pass
+    SHADER_OVERDRAW = 1 << 5    //USE_OVERDRAW, a constant step per fragment instead of shading, blended additively to show overdraw
+};
+
+//Specialised programs built from one set of shader sources, compiled the first time a feature set is asked for
+class ShaderVariants {
+private:
+    //Variables
+    string vertexPath;
+    string fragmentPath;
+    function<void(Shader&)> setup; //Run once on every new variant, e.g. to assign sampler units
+    unordered_map<unsigned int, unique_ptr<Shader>> variants;
+
+    //Functions
+    static string defines(unsigned int features);
+public:
+    ShaderVariants(const string& _vertexPath, const string& _fragmentPath, function<void(Shader&)> _setup = nullptr);
+    Shader& get(unsigned int features);
+    size_t size() const;
+};
+
+#endif
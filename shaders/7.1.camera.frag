@@ -2,43 +2,72 @@
 
 
 struct Light {
+	vec3 Direction;
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+};
 
-vec3 Direction;
-vec3 ambient;
-vec3 diffuse;
-vec3 specular;
-
+// per-frame constants, filled once per frame from FrameData in frameData.h
+layout (std140) uniform FrameData
+{
+	mat4 view;
+	mat4 projection;
+	vec3 CameraPosition;
+	Light light;
 };
 
 out vec4 FragColor;
 
 in vec2 TexCoord;
+flat in float Layer;
 in vec3 Normal;
 in vec3 FragPos;
 
 // samplers
-uniform sampler2D texture1;
-uniform Light light;
-uniform vec3 CameraPosition;
+#ifdef USE_TEXTURE
+uniform sampler2DArray texture1;
+#else
+uniform vec3 baseColor; // flat color used in place of the texture
+#endif
+
+
+#ifdef USE_OVERDRAW
+// added once per shaded fragment, so brightness counts the layers: dark red for one, orange at 8, yellow at 16, white at 32
+const vec3 OVERDRAW_STEP = vec3(0.125, 0.0625, 0.03125);
+#endif
 
 
 void main()
 {
+#if defined(USE_DEPTH_ONLY)
+	// colour writes are masked off during the depth pre-pass, only the depth test runs
+	FragColor = vec4(0.0);
+#elif defined(USE_OVERDRAW)
+	FragColor = vec4(OVERDRAW_STEP, 1.0);
+#else
+#ifdef USE_TEXTURE
+    vec3 albedo = texture(texture1, vec3(TexCoord, Layer)).rgb;
+#else
+    vec3 albedo = baseColor;
+#endif
 
-
-    vec3 ambientResult = (light.ambient,1) * texture(texture1, TexCoord).rgb;
+    vec3 ambientResult = (light.ambient,1) * albedo;
 
     vec3 norm = normalize(Normal);
     vec3 lightDir = normalize(-light.Direction);  
     float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuseResult = light.diffuse * diff * texture(texture1, TexCoord).rgb;  
+    vec3 diffuseResult = light.diffuse * diff * albedo;  
 
+    vec3 finalResult = ambientResult * diffuseResult + 0.1 * albedo;
+
+#ifdef USE_SPECULAR
     vec3 viewDir = normalize(CameraPosition - FragPos);
     vec3 reflectDir = reflect(-lightDir, norm);  
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 30);
-    vec3 specular = light.specular * spec * texture(texture1, TexCoord).rgb;  
-
-    vec3 finalResult = ambientResult * diffuseResult + 0.1 * texture(texture1, TexCoord).rgb + specular;
+    finalResult += light.specular * spec * albedo;  
+#endif
 
 	FragColor = vec4(finalResult,1);
+#endif
 }
\ No newline at end of file
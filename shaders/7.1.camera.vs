@@ -1,20 +1,63 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoord;
+#ifdef USE_PACKED_VERTICES
+layout (location = 2) in vec2 aNormal; // octahedral encoded, see octahedralEncode in vertex.h
+#else
 layout (location = 2) in vec3 aNormal;
+#endif
+#ifdef USE_INSTANCING
+layout (location = 3) in mat4 aModel; // per-instance, occupies locations 3-6
+layout (location = 7) in float aLayer; // per-instance texture array layer
+#else
+uniform mat4 aModel; // single object drawn with plain uniforms
+uniform float aLayer;
+#endif
+
+// the depth pre-pass and the lit pass run different programs, their depths have to match exactly for GL_LEQUAL
+invariant gl_Position;
 
 out vec2 TexCoord;
+flat out float Layer;
 out vec3 Normal;
 out vec3 FragPos;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+struct Light {
+	vec3 Direction;
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+};
+
+// per-frame constants, filled once per frame from FrameData in frameData.h
+layout (std140) uniform FrameData
+{
+	mat4 view;
+	mat4 projection;
+	vec3 CameraPosition;
+	Light light;
+};
+
+#ifdef USE_PACKED_VERTICES
+// unfolds an octahedral encoded normal
+vec3 octahedralDecode(vec2 encoded)
+{
+	vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	if (normal.z < 0.0)
+		normal.xy = (1.0 - abs(normal.yx)) * vec2(normal.x >= 0.0 ? 1.0 : -1.0, normal.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(normal);
+}
+#endif
 
 void main()
 {
-	gl_Position = projection * view * model * vec4(aPos, 1.0f);
+	gl_Position = projection * view * aModel * vec4(aPos, 1.0f);
 	TexCoord = vec2(aTexCoord.x, aTexCoord.y);
+	Layer = aLayer;
+#ifdef USE_PACKED_VERTICES
+	Normal = octahedralDecode(aNormal);
+#else
 	Normal = aNormal;
-	FragPos = vec3(model * vec4(aPos, 1.0));
+#endif
+	FragPos = vec3(aModel * vec4(aPos, 1.0));
 }
\ No newline at end of file
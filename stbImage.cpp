@@ -0,0 +1,3 @@
+//Texture loader, the stb_image implementation is compiled here once and every other file includes just its declarations
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
@@ -0,0 +1,231 @@
+#ifndef textureLoader_header
+#define textureLoader_header
+
+#include <glad/glad.h>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include <memory>
+#include "stb_image.h"
+#include "learnopengl/filesystem.h"
+#include "assetPack.h"
+#include "cookedTexture.h"
+
+using namespace std;
+
+//RGBA pixels of one layer, decoded and resized on a worker thread and uploaded on the GL thread
+struct DecodedImage
+{
+	vector<unsigned char> pixels;
+	bool loaded = false;
+};
+
+GLuint loadTextureArray(const vector<string>& paths, int layerSize, bool usePBO);
+void setTextureParameters();
+bool cookedFormatSupported(uint32_t format);
+bool cookedLayersMatch(const vector<const CookedTextureHeader*>& headers);
+void uploadCookedLayers(const vector<unique_ptr<Asset>>& cooked, const vector<const CookedTextureHeader*>& headers);
+void uploadLayer(int layer, int layerSize, const DecodedImage& image, GLuint pbo);
+
+/// <summary>
+/// Loads a set of images into the layers of one GL_TEXTURE_2D_ARRAY, so every object can be
+/// drawn with the same texture binding and pick its image through a per-instance layer index.
+/// If every image has an up to date .ptex from TextureCooker with the same size and format, the
+/// layers are uploaded straight from the asset pack or mapped files with no decoding. Otherwise the images are
+/// decoded and resized to layerSize concurrently on a pool of worker threads, and the GL thread
+/// uploads each layer as soon as it is ready.
+/// </summary>
+/// <param name="paths">Texture paths, passed through FileSystem::getPath. Layer i holds paths[i].</param>
+/// <param name="layerSize">Width and height of each layer when decoding</param>
+/// <param name="usePBO">Stream the pixels through a pixel buffer object so the upload runs asynchronously</param>
+/// <returns>The texture array</returns>
+GLuint loadTextureArray(const vector<string>& paths, int layerSize, bool usePBO) {
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	setTextureParameters();
+	if (paths.empty()) return texture;
+
+	//Cooked layers can only be used if all of them are cooked alike
+	vector<unique_ptr<Asset>> cooked(paths.size());
+	vector<const CookedTextureHeader*> headers(paths.size());
+	for (size_t i = 0; i < paths.size(); i++) {
+		string source = FileSystem::getPath(paths[i]);
+		cooked[i].reset(new Asset(source + ".ptex"));
+		headers[i] = cookedTextureHeader(*cooked[i], source);
+	}
+	if (cookedLayersMatch(headers)) {
+		uploadCookedLayers(cooked, headers);
+		cout << "Texture array: " << paths.size() << " cooked layers" << endl;
+		return texture;
+	}
+	cooked.clear();
+
+	int levels = 1;
+	while ((layerSize >> levels) > 0) levels++;
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, GL_RGBA8, layerSize, layerSize, paths.size());
+
+	vector<DecodedImage> images(paths.size());
+	mutex lock;
+	condition_variable decodedSignal;
+	vector<int> decoded; //Indices of images ready for upload, in completion order
+	atomic<int> next(0);
+
+	//Workers pull the next path until all are taken
+	int workerCount = max(1, min((int)thread::hardware_concurrency(), (int)paths.size()));
+	vector<thread> workers;
+	for (int w = 0; w < workerCount; w++) {
+		workers.emplace_back([&]() {
+			int i;
+			while ((i = next++) < (int)paths.size()) {
+				DecodedImage& image = images[i];
+				int width, height, channels;
+				Asset source(FileSystem::getPath(paths[i]));
+				unsigned char* pixels = source.isOpen() ? stbi_load_from_memory(source.data(), (int)source.size(), &width, &height, &channels, 4) : nullptr;
+				if (pixels) {
+					image.pixels.resize((size_t)layerSize * layerSize * 4);
+					resampleRGBA8(pixels, width, height, image.pixels.data(), layerSize, layerSize);
+					image.loaded = true;
+				}
+				stbi_image_free(pixels);
+
+				lock_guard<mutex> guard(lock);
+				decoded.push_back(i);
+				decodedSignal.notify_one();
+			}
+		});
+	}
+
+	GLuint pbo = 0;
+	if (usePBO) glGenBuffers(1, &pbo);
+
+	//Upload in whatever order the workers finish
+	for (size_t uploaded = 0; uploaded < paths.size(); uploaded++) {
+		int i;
+		{
+			unique_lock<mutex> guard(lock);
+			decodedSignal.wait(guard, [&]() { return uploaded < decoded.size(); });
+			i = decoded[uploaded];
+		}
+
+		if (images[i].loaded) {
+			uploadLayer(i, layerSize, images[i], pbo);
+		}
+		else {
+			std::cout << "Failed to load texture from " << paths[i] << std::endl;
+		}
+		images[i].pixels = vector<unsigned char>();
+	}
+
+	for (auto& worker : workers) worker.join();
+	if (pbo) glDeleteBuffers(1, &pbo);
+
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	cout << "Texture array: " << paths.size() << " decoded layers of " << layerSize << "x" << layerSize << endl;
+	return texture;
+}
+
+/// <summary>
+/// Wrapping and filtering shared by every texture, applied to the bound GL_TEXTURE_2D_ARRAY
+/// </summary>
+void setTextureParameters() {
+	// set the texture wrapping parameters
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// set texture filtering parameters, sampling from the mip chain when minified
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+/// <summary>
+/// Uploads one decoded layer
+/// </summary>
+/// <param name="layer">Array layer to fill</param>
+/// <param name="layerSize">Width and height of the layer</param>
+/// <param name="image">Decoded RGBA pixels</param>
+/// <param name="pbo">Pixel buffer object to stage the pixels in, or 0 to upload straight from memory</param>
+void uploadLayer(int layer, int layerSize, const DecodedImage& image, GLuint pbo) {
+	size_t size = image.pixels.size();
+	const void* source = image.pixels.data();
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1); //Rows are tightly packed
+	if (pbo) {
+		//Copy into driver-owned memory, glTexSubImage3D then reads from the buffer without stalling on the copy
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+		void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (mapped) {
+			memcpy(mapped, image.pixels.data(), size);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			source = nullptr; //Offset 0 into the bound buffer
+		}
+		else {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		}
+	}
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, layerSize, layerSize, 1, GL_RGBA, GL_UNSIGNED_BYTE, source);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+/// <summary>
+/// Checks if the driver can sample a cooked texture format
+/// </summary>
+/// <param name="format">Cooked texture format</param>
+/// <returns>true if it can be uploaded as is</returns>
+bool cookedFormatSupported(uint32_t format) {
+	if (format == COOKED_RGBA8) return true;
+
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &count);
+	vector<GLint> formats(count);
+	if (count > 0) glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, formats.data());
+	return find(formats.begin(), formats.end(), GL_COMPRESSED_RGB_S3TC_DXT1_EXT) != formats.end();
+}
+
+/// <summary>
+/// Checks that every layer has a valid cooked texture and that they can share one array
+/// </summary>
+/// <param name="headers">Cooked header per layer, nullptr where missing or stale</param>
+/// <returns>true if all layers can be uploaded from their cooked files</returns>
+bool cookedLayersMatch(const vector<const CookedTextureHeader*>& headers) {
+	for (auto header : headers) {
+		if (!header) return false;
+		if (header->format != headers[0]->format || header->width != headers[0]->width
+			|| header->height != headers[0]->height || header->levelCount != headers[0]->levelCount) return false;
+	}
+	return cookedFormatSupported(headers[0]->format);
+}
+
+/// <summary>
+/// Allocates the bound texture array and uploads every cooked layer straight from its mapping, one mip level at a time
+/// </summary>
+/// <param name="cooked">.ptex file per layer</param>
+/// <param name="headers">Their validated headers</param>
+void uploadCookedLayers(const vector<unique_ptr<Asset>>& cooked, const vector<const CookedTextureHeader*>& headers) {
+	const CookedTextureHeader* first = headers[0];
+	bool compressed = first->format == COOKED_BC1;
+	GLenum internalFormat = compressed ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_RGBA8;
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, first->levelCount, internalFormat, first->width, first->height, headers.size());
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (size_t layer = 0; layer < headers.size(); layer++) {
+		const CookedTextureLevel* levels = cookedTextureLevels(headers[layer]);
+		for (uint32_t i = 0; i < first->levelCount; i++) {
+			const unsigned char* pixels = cooked[layer]->data() + levels[i].offset;
+			if (compressed) {
+				glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, i, 0, 0, layer, levels[i].width, levels[i].height, 1, internalFormat, (GLsizei)levels[i].size, pixels);
+			}
+			else {
+				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, i, 0, 0, layer, levels[i].width, levels[i].height, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+			}
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,156 @@
+//Offline asset packer: collects every file under the given directories into one archive that the game maps
+//with a single call and serves as in-place views. See assetPack.h for the layout.
+//Usage: AssetPacker <output> <root> <directory>...
+//Directories are relative to root and the files keep their root relative path as name, e.g. "shaders/7.1.camera.vs".
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <filesystem>
+
+#include "assetPack.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+//The packer never reads from a pack itself, Asset lookups just miss
+AssetPack assets;
+
+//One file going into the pack
+struct PackedFile
+{
+	string name;
+	fs::path path;
+	uint64_t size;
+	uint64_t hash;
+};
+
+/// <summary>
+/// Tells if a file belongs in the pack. Driver specific caches and earlier packs are left out.
+/// </summary>
+/// <param name="path">File to check</param>
+/// <returns>true if it should be packed</returns>
+bool packable(const fs::path& path) {
+	string extension = path.extension().string();
+	return extension != ".progbin" && extension != ".pack";
+}
+
+/// <summary>
+/// Pads the output to the next multiple of the alignment
+/// </summary>
+/// <param name="out">Pack being written</param>
+/// <param name="offset">Current offset, moved to the aligned position</param>
+void align(ofstream& out, uint64_t& offset) {
+	static const char padding[ASSET_PACK_ALIGNMENT] = {};
+	uint64_t aligned = (offset + ASSET_PACK_ALIGNMENT - 1) / ASSET_PACK_ALIGNMENT * ASSET_PACK_ALIGNMENT;
+	out.write(padding, aligned - offset);
+	offset = aligned;
+}
+
+/// <summary>
+/// Writes the pack, through a temporary file so a running game never maps a half written pack
+/// </summary>
+/// <param name="output">Pack to write</param>
+/// <param name="files">Files to store, sorted by name</param>
+/// <returns>true on success</returns>
+bool writePack(const fs::path& output, const vector<PackedFile>& files) {
+	string names;
+	vector<AssetPackEntry> entries(files.size());
+	for (size_t i = 0; i < files.size(); i++) {
+		entries[i].nameOffset = names.size();
+		entries[i].nameLength = files[i].name.size();
+		entries[i].size = files[i].size;
+		entries[i].hash = files[i].hash;
+		names += files[i].name;
+	}
+
+	//Blobs follow the table of contents, each on its own aligned offset
+	uint64_t offset = sizeof(AssetPackHeader) + sizeof(AssetPackEntry) * entries.size() + names.size();
+	for (auto& entry : entries) {
+		offset = (offset + ASSET_PACK_ALIGNMENT - 1) / ASSET_PACK_ALIGNMENT * ASSET_PACK_ALIGNMENT;
+		entry.offset = offset;
+		offset += entry.size;
+	}
+
+	AssetPackHeader header = {};
+	memcpy(header.magic, ASSET_PACK_MAGIC, 4);
+	header.version = ASSET_PACK_VERSION;
+	header.entryCount = entries.size();
+	header.namesSize = names.size();
+
+	fs::path temporary = output;
+	temporary += ".tmp";
+	{
+		ofstream out(temporary, ios::binary | ios::trunc);
+		out.write((const char*)&header, sizeof(header));
+		out.write((const char*)entries.data(), sizeof(AssetPackEntry) * entries.size());
+		out.write(names.data(), names.size());
+
+		offset = sizeof(AssetPackHeader) + sizeof(AssetPackEntry) * entries.size() + names.size();
+		for (size_t i = 0; i < files.size(); i++) {
+			align(out, offset);
+			MappedFile file(files[i].path.string());
+			if (files[i].size > 0 && (!file.isOpen() || file.size() != files[i].size)) {
+				cerr << files[i].path.string() << ": changed while packing" << endl;
+				return false;
+			}
+			out.write((const char*)file.data(), files[i].size);
+			offset += files[i].size;
+		}
+		if (!out) {
+			cerr << "Failed to write " << temporary.string() << endl;
+			return false;
+		}
+	}
+
+	error_code error;
+	fs::rename(temporary, output, error);
+	if (error) {
+		cerr << "Failed to replace " << output.string() << ": " << error.message() << endl;
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char** argv) {
+	if (argc < 4) {
+		cerr << "Usage: AssetPacker <output> <root> <directory>..." << endl;
+		return 1;
+	}
+
+	fs::path output = argv[1];
+	fs::path root = argv[2];
+	vector<PackedFile> files;
+	uint64_t totalSize = 0;
+
+	for (int i = 3; i < argc; i++) {
+		fs::path directory = root / argv[i];
+		if (!fs::is_directory(directory)) {
+			cerr << directory.string() << ": not a directory" << endl;
+			return 1;
+		}
+		for (auto& item : fs::recursive_directory_iterator(directory)) {
+			if (!item.is_regular_file() || !packable(item.path())) continue;
+
+			PackedFile file;
+			file.path = item.path();
+			file.name = fs::relative(item.path(), root).generic_string();
+			MappedFile mapped(file.path.string());
+			file.size = mapped.size();
+			file.hash = mapped.isOpen() ? hashBytes(mapped.data(), mapped.size()) : 0;
+			totalSize += file.size;
+			files.push_back(file);
+		}
+	}
+
+	//The game looks names up with a binary search
+	sort(files.begin(), files.end(), [](const PackedFile& a, const PackedFile& b) { return a.name < b.name; });
+
+	if (!writePack(output, files)) return 1;
+	cout << output.string() << ": " << files.size() << " files, " << totalSize << " bytes" << endl;
+	return 0;
+}
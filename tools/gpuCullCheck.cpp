@@ -0,0 +1,240 @@
+//Headless check of the GPU culling: runs shaders/cull.comp and shaders/hiz.comp through GpuCulling on an offscreen
+//EGL context and compares the commands it reads back with the same tests done on the CPU. Runs without a window,
+//so Mesa's llvmpipe will do (LIBGL_ALWAYS_SOFTWARE=1).
+//Usage: GpuCullCheck <repository root>
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <set>
+#include <cstdlib>
+#include <cmath>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <glad/glad.h>
+#include "assetPack.h"
+
+//The check always reads loose files, Asset lookups just miss
+AssetPack assets;
+
+#include "gpuCulling.h"
+#include "glm/glm/gtc/matrix_transform.hpp"
+
+using namespace std;
+
+const int WIDTH = 320;
+const int HEIGHT = 200;
+const float FIELD_OF_VIEW = 45.0f;
+const int LOD_COUNT = 4;
+const float LOD_FULL_DETAIL_PIXELS = 100.0f;
+const float OCCLUDER_DISTANCE = 10.5f; // Distance of the depth the pyramid is built from, halfway between two objects of the row
+
+/// <summary>
+/// Makes an offscreen OpenGL 4.3 core context current, on the surfaceless platform when Mesa offers it
+/// </summary>
+/// <returns>true on success</returns>
+bool createContext() {
+	EGLDisplay display = EGL_NO_DISPLAY;
+	auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay) display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	if (display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+		cerr << "Failed to initialize EGL" << endl;
+		return false;
+	}
+
+	const EGLint configAttributes[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_DEPTH_SIZE, 24, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+	EGLConfig config;
+	EGLint configCount = 0;
+	if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0) {
+		cerr << "No EGL config with a depth buffer" << endl;
+		return false;
+	}
+	const EGLint surfaceAttributes[] = { EGL_WIDTH, WIDTH, EGL_HEIGHT, HEIGHT, EGL_NONE };
+	EGLSurface surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+
+	eglBindAPI(EGL_OPENGL_API);
+	const EGLint contextAttributes[] = { EGL_CONTEXT_MAJOR_VERSION, 4, EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE };
+	EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, surface, surface, context)) {
+		cerr << "Failed to create an OpenGL 4.3 core context" << endl;
+		return false;
+	}
+	if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+		cerr << "Failed to initialize GLAD" << endl;
+		return false;
+	}
+	cout << "Renderer: " << glGetString(GL_RENDERER) << endl;
+	return true;
+}
+
+/// <summary>
+/// Level of detail the compute shader should pick, the same formula as selectLod in main.cpp
+/// </summary>
+/// <param name="position">Object center</param>
+/// <param name="radius">Object radius</param>
+/// <param name="camera">Camera position</param>
+/// <returns>Level of detail</returns>
+int expectedLod(glm::vec3 position, float radius, glm::vec3 camera) {
+	float distance = max(glm::distance(position, camera), radius);
+	float pixels = radius * HEIGHT / (distance * tan(glm::radians(FIELD_OF_VIEW) / 2));
+	int lod = 0;
+	while (lod < LOD_COUNT - 1 && pixels < LOD_FULL_DETAIL_PIXELS / (float)(1 << lod)) {
+		lod++;
+	}
+	return lod;
+}
+
+/// <summary>
+/// Culls, waits for the GPU and reads the commands back the way the game's report does
+/// </summary>
+/// <param name="culling">Culling to run</param>
+/// <param name="frustum">View frustum</param>
+/// <param name="camera">Camera position</param>
+/// <returns>true if the commands were read back</returns>
+bool cullAndRead(GpuCulling& culling, const Frustum& frustum, glm::vec3 camera) {
+	culling.cull(frustum, camera);
+	glFinish();
+	if (!culling.readBackCommands()) {
+		cerr << "Commands were not read back after glFinish" << endl;
+		return false;
+	}
+	return true;
+}
+
+/// <summary>
+/// Compares a read-back count with the CPU's and reports it
+/// </summary>
+/// <param name="name">Count name for the report</param>
+/// <param name="actual">Count read back from the GPU</param>
+/// <param name="expected">Count from the CPU</param>
+/// <returns>true if they match</returns>
+bool checkCount(const string& name, int actual, int expected) {
+	cout << name << ": " << actual << " (expected " << expected << ")" << (actual == expected ? "" : " FAILED") << endl;
+	return actual == expected;
+}
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		cerr << "Usage: GpuCullCheck <repository root>" << endl;
+		return EXIT_FAILURE;
+	}
+	string root = argv[1];
+	if (root.back() != '/') root += '/';
+	if (!createContext()) return EXIT_FAILURE;
+
+	glm::vec3 camera(0.0f);
+	glm::mat4 projection = glm::perspective(glm::radians(FIELD_OF_VIEW), (float)WIDTH / HEIGHT, 0.1f, 100.0f);
+	glm::mat4 viewProjection = projection * glm::lookAt(camera, glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	Frustum frustum = extractFrustum(viewProjection);
+
+	GpuCulling culling((root + "shaders/cull.comp").c_str(), (root + "shaders/hiz.comp").c_str(), WIDTH, HEIGHT);
+	GLuint VAOs[2];
+	glGenVertexArrays(2, VAOs);
+
+	//Like the wall chunks: no instance data, one command per object. In front, behind, off to the side and past the far plane.
+	vector<CullObject> chunkObjects = {
+		{ glm::vec4(0.0f, 0.0f, -2.0f, 0.5f), 0, -1, {} },
+		{ glm::vec4(0.0f, 0.0f, 5.0f, 0.5f), 1, -1, {} },
+		{ glm::vec4(100.0f, 0.0f, -2.0f, 0.5f), 2, -1, {} },
+		{ glm::vec4(0.0f, 0.0f, -150.0f, 0.5f), 3, -1, {} } };
+	vector<DrawElementsIndirectCommand> chunkCommands(chunkObjects.size(), { 3, 0, 0, 0, 0 });
+	int chunkBatch = culling.addBatch(chunkObjects, chunkCommands, VAOs[0], 0, 0);
+
+	//Like the ghosts: a row of instanced objects walking away from the camera, each picking its level of detail.
+	//Every instance float is tagged with its object and position in the instance so the copies can be traced back.
+	const int ROW = 100;
+	const float ROW_RADIUS = 1.2f;
+	vector<CullObject> rowObjects;
+	vector<float> sourceData(ROW * sizeof(Instance) / sizeof(float));
+	const int instanceFloats = sizeof(Instance) / sizeof(float);
+	for (int i = 0; i < ROW; i++) {
+		rowObjects.push_back({ glm::vec4(0.0f, 0.0f, -1.0f - i, ROW_RADIUS), -1, i, {} });
+		for (int k = 0; k < instanceFloats; k++) sourceData[i * instanceFloats + k] = (float)(i * 100 + k + 1);
+	}
+	GLuint sourceInstances;
+	glGenBuffers(1, &sourceInstances);
+	glBindBuffer(GL_ARRAY_BUFFER, sourceInstances);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(float) * sourceData.size(), sourceData.data(), GL_STATIC_DRAW);
+	vector<DrawElementsIndirectCommand> rowCommands;
+	for (int lod = 0; lod < LOD_COUNT; lod++) rowCommands.push_back({ 3, 0, 0, 0, (GLuint)(lod * ROW) });
+	int rowBatch = culling.addBatch(rowObjects, rowCommands, VAOs[1], sourceInstances, LOD_COUNT * ROW);
+	culling.finishBatches();
+	culling.setLodSelection(LOD_COUNT, HEIGHT / tan(glm::radians(FIELD_OF_VIEW) / 2), LOD_FULL_DETAIL_PIXELS);
+
+	//The culled instance buffer is the one now attached to the VAO, zeroed so unfilled slots stand out from the tags
+	GLint culledInstances;
+	glBindVertexArray(VAOs[1]);
+	glGetVertexAttribiv(3, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &culledInstances);
+	glBindVertexArray(0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, culledInstances);
+	glClearBufferData(GL_COPY_WRITE_BUFFER, GL_R32F, GL_RED, GL_FLOAT, nullptr);
+
+	int failures = 0;
+
+	//Frustum only
+	int chunksVisible = 0;
+	for (auto& object : chunkObjects) chunksVisible += sphereVisible(frustum, glm::vec3(object.sphere), object.sphere.w);
+	int rowVisible = 0;
+	for (auto& object : rowObjects) rowVisible += sphereVisible(frustum, glm::vec3(object.sphere), object.sphere.w);
+	if (!cullAndRead(culling, frustum, camera)) return EXIT_FAILURE;
+	failures += !checkCount("frustum: chunks drawn", culling.commandsDrawn(chunkBatch), chunksVisible);
+	failures += !checkCount("frustum: row instances", culling.instancesDrawn(rowBatch), rowVisible);
+
+	//Every visible row object lands in the command of its level of detail, with its own instance data
+	int lodCounts[LOD_COUNT] = {};
+	for (auto& object : rowObjects) {
+		if (sphereVisible(frustum, glm::vec3(object.sphere), object.sphere.w)) lodCounts[expectedLod(glm::vec3(object.sphere), object.sphere.w, camera)]++;
+	}
+	vector<float> culledData(LOD_COUNT * ROW * instanceFloats);
+	glBindBuffer(GL_COPY_READ_BUFFER, culledInstances);
+	glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(float) * culledData.size(), culledData.data());
+	for (int lod = 0; lod < LOD_COUNT; lod++) {
+		//Each level's range is filled from its start, the first zeroed slot ends it
+		set<int> seen;
+		int copied = 0;
+		const float* level = &culledData[lod * ROW * instanceFloats];
+		for (int slot = 0; slot < ROW; slot++) {
+			if (level[slot * instanceFloats] == 0.0f) break;
+			int object = (int)level[slot * instanceFloats] / 100;
+			if (object >= ROW) break;
+			bool intact = true;
+			for (int k = 0; k < instanceFloats; k++) intact &= level[slot * instanceFloats + k] == (float)(object * 100 + k + 1);
+			bool rightLod = expectedLod(glm::vec3(rowObjects[object].sphere), ROW_RADIUS, camera) == lod;
+			if (intact && rightLod && seen.insert(object).second) copied++;
+		}
+		failures += !checkCount("lod " + to_string(lod) + ": instances copied intact", copied, lodCounts[lod]);
+	}
+
+	//Behind a depth buffer cleared to a wall across the view, only the row objects reaching in front of it survive
+	glm::vec4 occluderClip = projection * glm::vec4(0.0f, 0.0f, -OCCLUDER_DISTANCE, 1.0f);
+	float occluderDepth = occluderClip.z / occluderClip.w * 0.5f + 0.5f;
+	glClearDepth(occluderDepth);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	culling.buildHiZ(viewProjection);
+	int rowInFront = 0;
+	for (auto& object : rowObjects) {
+		rowInFront += sphereVisible(frustum, glm::vec3(object.sphere), object.sphere.w) && -(object.sphere.z + object.sphere.w) < OCCLUDER_DISTANCE;
+	}
+	if (!cullAndRead(culling, frustum, camera)) return EXIT_FAILURE;
+	failures += !checkCount("depth pyramid: row instances", culling.instancesDrawn(rowBatch), rowInFront);
+
+	//Removed objects stop drawing, the way eaten pellets do
+	glClearDepth(1.0);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	culling.buildHiZ(viewProjection);
+	culling.updateSphere(chunkBatch, 0, glm::vec4(0.0f));
+	if (!cullAndRead(culling, frustum, camera)) return EXIT_FAILURE;
+	failures += !checkCount("removed: chunks drawn", culling.commandsDrawn(chunkBatch), chunksVisible - 1);
+
+	GLenum error = glGetError();
+	if (error != GL_NO_ERROR) {
+		cerr << "OpenGL error 0x" << hex << error << endl;
+		failures++;
+	}
+	glDeleteVertexArrays(2, VAOs);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
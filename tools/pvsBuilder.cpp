@@ -0,0 +1,245 @@
+//Offline potentially visible set builder: for every walkable cell of a level, finds the cells a viewer standing
+//anywhere in it could see, and writes the sets next to the level as <level>.pvs for the game to look up. See levelPvs.h for the layout.
+//Each cell is raycast from a few viewpoints across it, then merged with the sets of its walkable neighbours,
+//which covers viewpoints between the samples and a camera standing on the border of two cells.
+//Usage: PvsBuilder [--radius <cells>] [--threads <count>] <level>...
+//The radius should match the game's view distance, nothing further away is recorded.
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "levelPvs.h"
+
+using namespace std;
+
+//The builder always reads loose levels, Asset lookups just miss
+AssetPack assets;
+
+const int FIRST_RAYS = 128; // Evenly spaced rays every viewpoint starts with, refined where they reach far
+const float RAY_SPACING = 0.25f; // Largest gap in cells left between neighbouring rays where they stop
+const float VIEWPOINT_OFFSETS[3] = { -0.49f, 0.0f, 0.49f }; // Viewpoints across a cell along each axis, corners included
+
+/// <summary>
+/// Reads the wall layout of a level file, the same way the game does
+/// </summary>
+/// <param name="path">Level file</param>
+/// <param name="grid">Grid to fill</param>
+/// <returns>true on success</returns>
+bool readLevelGrid(const string& path, LevelGrid& grid) {
+	ifstream lvlFile(path);
+	string size;
+	if (!(lvlFile >> size)) return false;
+	size_t separator = size.find('x');
+	if (separator == string::npos) return false;
+	int xMax = atoi(size.substr(0, separator).c_str());
+	int yMax = atoi(size.substr(separator + 1).c_str());
+
+	//Rows of the file run along x in world space
+	grid = LevelGrid(yMax, xMax);
+	for (int i = 0; i < yMax; i++) {
+		for (int j = 0; j < xMax; j++) {
+			int data;
+			if (!(lvlFile >> data)) return false;
+			if (data == 1) grid.setWall(i, j, true);
+		}
+	}
+	return true;
+}
+
+/// <summary>
+/// Casts rays between two directions, adding rays in between until neighbouring ones are at most RAY_SPACING apart where they stop
+/// </summary>
+/// <param name="grid">Level grid</param>
+/// <param name="origin">Viewpoint</param>
+/// <param name="firstAngle">Direction of the first ray</param>
+/// <param name="firstDistance">Distance the first ray travelled</param>
+/// <param name="lastAngle">Direction of the last ray</param>
+/// <param name="lastDistance">Distance the last ray travelled</param>
+/// <param name="radius">Longest line of sight</param>
+/// <param name="visibility">Visibility to mark</param>
+void refineRays(const LevelGrid& grid, glm::vec2 origin, float firstAngle, float firstDistance, float lastAngle, float lastDistance,
+	float radius, LevelVisibility& visibility) {
+	if (max(firstDistance, lastDistance) * (lastAngle - firstAngle) <= RAY_SPACING) return;
+
+	float angle = (firstAngle + lastAngle) * 0.5f;
+	float distance = castVisibilityRay(grid, origin, glm::vec2(cos(angle), sin(angle)), radius, visibility);
+	refineRays(grid, origin, firstAngle, firstDistance, angle, distance, radius, visibility);
+	refineRays(grid, origin, angle, distance, lastAngle, lastDistance, radius, visibility);
+}
+
+/// <summary>
+/// Marks every cell visible from somewhere inside one cell, looking in all directions
+/// </summary>
+/// <param name="grid">Level grid</param>
+/// <param name="x">x cell</param>
+/// <param name="z">z cell</param>
+/// <param name="radius">Longest line of sight</param>
+/// <param name="visibility">Visibility to fill</param>
+void castCell(const LevelGrid& grid, int x, int z, float radius, LevelVisibility& visibility) {
+	const float PI = 3.14159265f;
+	visibility.begin();
+	for (float offsetZ : VIEWPOINT_OFFSETS) {
+		for (float offsetX : VIEWPOINT_OFFSETS) {
+			glm::vec2 origin = glm::vec2(x + offsetX, z + offsetZ);
+			float distances[FIRST_RAYS + 1];
+			for (int ray = 0; ray < FIRST_RAYS; ray++) {
+				float angle = 2 * PI * ray / FIRST_RAYS;
+				distances[ray] = castVisibilityRay(grid, origin, glm::vec2(cos(angle), sin(angle)), radius, visibility);
+			}
+			distances[FIRST_RAYS] = distances[0];
+			for (int ray = 0; ray < FIRST_RAYS; ray++) {
+				refineRays(grid, origin, 2 * PI * ray / FIRST_RAYS, distances[ray], 2 * PI * (ray + 1) / FIRST_RAYS, distances[ray + 1], radius, visibility);
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Runs a function on every row of cells, handing rows out to the worker threads one at a time
+/// </summary>
+/// <param name="grid">Level grid</param>
+/// <param name="threadCount">Number of worker threads</param>
+/// <param name="processRow">Called once per row with the worker's own visibility to work in</param>
+void forEachRow(const LevelGrid& grid, int threadCount, const function<void(int, LevelVisibility&)>& processRow) {
+	atomic<int> nextRow(0);
+	auto worker = [&]() {
+		LevelVisibility visibility(grid);
+		int row;
+		while ((row = nextRow++) < grid.getSizeZ()) {
+			processRow(row, visibility);
+		}
+	};
+	vector<thread> workers;
+	for (int i = 0; i < threadCount; i++) workers.emplace_back(worker);
+	for (auto& thread : workers) thread.join();
+}
+
+/// <summary>
+/// Builds and writes the potentially visible sets of one level
+/// </summary>
+/// <param name="path">Level file</param>
+/// <param name="radius">Longest line of sight</param>
+/// <param name="threadCount">Number of worker threads</param>
+/// <returns>true on success</returns>
+bool build(const string& path, int radius, int threadCount) {
+	auto start = chrono::steady_clock::now();
+	LevelGrid grid;
+	if (!readLevelGrid(path, grid)) {
+		cerr << "Failed to read " << path << endl;
+		return false;
+	}
+	int sizeX = grid.getSizeX(), sizeZ = grid.getSizeZ();
+	if (sizeX > 65535 || sizeZ > 65535) {
+		cerr << path << ": levels are limited to 65535 cells per side" << endl;
+		return false;
+	}
+
+	//Sets seen from inside each cell, with offsets into their own row's data
+	vector<PvsCell> castCells((size_t)sizeX * sizeZ);
+	vector<vector<uint8_t>> castData(sizeZ);
+	atomic<int> walkableCells(0);
+	forEachRow(grid, threadCount, [&](int row, LevelVisibility& visibility) {
+		for (int x = 0; x < sizeX; x++) {
+			if (!grid.isWalkable(x, row)) continue;
+			castCell(grid, x, row, (float)radius, visibility);
+			castCells[(size_t)row * sizeX + x] = encodePvsCell(grid, visibility, castData[row]);
+			walkableCells++;
+		}
+	});
+
+	//Final sets, each the union of the cell's own set and those of its walkable neighbours
+	vector<PvsCell> cells((size_t)sizeX * sizeZ);
+	vector<vector<uint8_t>> rowData(sizeZ);
+	forEachRow(grid, threadCount, [&](int row, LevelVisibility& visibility) {
+		for (int x = 0; x < sizeX; x++) {
+			if (!grid.isWalkable(x, row)) continue;
+			visibility.begin();
+			const int neighbours[5][2] = { { 0, 0 }, { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+			for (auto& neighbour : neighbours) {
+				int nx = x + neighbour[0], nz = row + neighbour[1];
+				if (!grid.isWalkable(nx, nz)) continue;
+				const PvsCell& cell = castCells[(size_t)nz * sizeX + nx];
+				decodePvsCell(cell, castData[nz].data() + cell.offset, grid, visibility);
+			}
+			cells[(size_t)row * sizeX + x] = encodePvsCell(grid, visibility, rowData[row]);
+		}
+	});
+
+	//Rows were encoded on their own, move their offsets to where the rows end up in the file
+	uint64_t dataSize = 0;
+	for (int row = 0; row < sizeZ; row++) {
+		for (int x = 0; x < sizeX; x++) {
+			cells[(size_t)row * sizeX + x].offset += dataSize;
+		}
+		dataSize += rowData[row].size();
+	}
+	if (dataSize > UINT32_MAX) {
+		cerr << path << ": sets do not fit in 4 GB, use a smaller --radius" << endl;
+		return false;
+	}
+
+	PvsHeader header = {};
+	memcpy(header.magic, PVS_MAGIC, 4);
+	header.version = PVS_VERSION;
+	header.sizeX = sizeX;
+	header.sizeZ = sizeZ;
+	header.radius = radius;
+	header.dataSize = dataSize;
+	struct stat source;
+	if (stat(path.c_str(), &source) == 0) {
+		header.sourceTime = source.st_mtime;
+		header.sourceSize = source.st_size;
+	}
+	header.sourceHash = hashFile(path);
+
+	string outPath = path + ".pvs";
+	ofstream out(outPath, ios::binary | ios::trunc);
+	out.write((const char*)&header, sizeof(header));
+	out.write((const char*)cells.data(), sizeof(PvsCell) * cells.size());
+	for (auto& data : rowData) {
+		out.write((const char*)data.data(), data.size());
+	}
+	if (!out) {
+		cerr << "Failed to write " << outPath << endl;
+		return false;
+	}
+
+	float seconds = chrono::duration<float>(chrono::steady_clock::now() - start).count();
+	cout << path << ": " << sizeX << "x" << sizeZ << ", " << walkableCells << " walkable cells, " << dataSize << " bytes of sets, "
+		<< seconds << " s on " << threadCount << " threads" << endl;
+	return true;
+}
+
+int main(int argc, char** argv) {
+	int radius = 100;
+	int threadCount = max(1u, thread::hardware_concurrency());
+	int failures = 0, levels = 0;
+
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--radius" && i + 1 < argc) radius = max(1, atoi(argv[++i]));
+		else if (arg == "--threads" && i + 1 < argc) threadCount = max(1, atoi(argv[++i]));
+		else {
+			levels++;
+			if (!build(arg, radius, threadCount)) failures++;
+		}
+	}
+
+	if (levels == 0) {
+		cerr << "Usage: PvsBuilder [--radius <cells>] [--threads <count>] <level>..." << endl;
+		return EXIT_FAILURE;
+	}
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,267 @@
+//Offline texture cooker: decodes an image once, builds its full mip chain and optionally
+//compresses it to BC1, then writes a .ptex container next to the image for the game to map at startup.
+//Usage: TextureCooker [--rgba8|--bc1] [--size <width>x<height>] <image>...
+//Give every image of a texture array the same --size so the game can upload the cooked layers as they are.
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "cookedTexture.h"
+
+using namespace std;
+
+//One mip level of RGBA8 pixels
+struct Image
+{
+	int width;
+	int height;
+	vector<unsigned char> pixels;
+};
+
+/// <summary>
+/// Halves an image with a 2x2 box filter. Odd edges reuse their last row/column.
+/// </summary>
+/// <param name="source">Image to downsample</param>
+/// <returns>Next mip level</returns>
+Image downsample(const Image& source) {
+	Image level;
+	level.width = max(1, source.width / 2);
+	level.height = max(1, source.height / 2);
+	level.pixels.resize((size_t)level.width * level.height * 4);
+
+	for (int y = 0; y < level.height; y++) {
+		int y0 = min(y * 2, source.height - 1), y1 = min(y * 2 + 1, source.height - 1);
+		for (int x = 0; x < level.width; x++) {
+			int x0 = min(x * 2, source.width - 1), x1 = min(x * 2 + 1, source.width - 1);
+			for (int c = 0; c < 4; c++) {
+				int sum = source.pixels[((size_t)y0 * source.width + x0) * 4 + c]
+					+ source.pixels[((size_t)y0 * source.width + x1) * 4 + c]
+					+ source.pixels[((size_t)y1 * source.width + x0) * 4 + c]
+					+ source.pixels[((size_t)y1 * source.width + x1) * 4 + c];
+				level.pixels[((size_t)y * level.width + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+			}
+		}
+	}
+	return level;
+}
+
+/// <summary>
+/// Packs an RGB colour into 5:6:5 bits
+/// </summary>
+uint16_t toRGB565(const float* rgb) {
+	int r = (int)(min(max(rgb[0], 0.f), 255.f) * 31 / 255 + 0.5f);
+	int g = (int)(min(max(rgb[1], 0.f), 255.f) * 63 / 255 + 0.5f);
+	int b = (int)(min(max(rgb[2], 0.f), 255.f) * 31 / 255 + 0.5f);
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+/// <summary>
+/// Expands a 5:6:5 colour back to 8 bits per channel
+/// </summary>
+void fromRGB565(uint16_t color, float* rgb) {
+	rgb[0] = (float)((color >> 11) & 31) * 255 / 31;
+	rgb[1] = (float)((color >> 5) & 63) * 255 / 63;
+	rgb[2] = (float)(color & 31) * 255 / 31;
+}
+
+/// <summary>
+/// Compresses one 4x4 block to BC1. The endpoints are the extremes of the block's colours
+/// along their principal axis, and every texel picks the nearest of the four palette colours.
+/// </summary>
+/// <param name="texels">16 RGB texels</param>
+/// <param name="out">8 bytes of BC1 data</param>
+void encodeBC1Block(const float texels[16][3], unsigned char* out) {
+	float mean[3] = { 0, 0, 0 };
+	for (int i = 0; i < 16; i++) for (int c = 0; c < 3; c++) mean[c] += texels[i][c] / 16;
+
+	float cov[6] = { 0, 0, 0, 0, 0, 0 }; //rr rg rb gg gb bb
+	for (int i = 0; i < 16; i++) {
+		float d[3] = { texels[i][0] - mean[0], texels[i][1] - mean[1], texels[i][2] - mean[2] };
+		cov[0] += d[0] * d[0]; cov[1] += d[0] * d[1]; cov[2] += d[0] * d[2];
+		cov[3] += d[1] * d[1]; cov[4] += d[1] * d[2]; cov[5] += d[2] * d[2];
+	}
+
+	//Power iteration for the principal axis
+	float axis[3] = { 1, 1, 1 };
+	for (int iteration = 0; iteration < 8; iteration++) {
+		float next[3] = {
+			cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+			cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+			cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2] };
+		float length = sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+		if (length < 1e-6f) break;
+		for (int c = 0; c < 3; c++) axis[c] = next[c] / length;
+	}
+
+	float lowest = 1e30f, highest = -1e30f;
+	int low = 0, high = 0;
+	for (int i = 0; i < 16; i++) {
+		float t = (texels[i][0] - mean[0]) * axis[0] + (texels[i][1] - mean[1]) * axis[1] + (texels[i][2] - mean[2]) * axis[2];
+		if (t < lowest) { lowest = t; low = i; }
+		if (t > highest) { highest = t; high = i; }
+	}
+
+	uint16_t color0 = toRGB565(texels[high]);
+	uint16_t color1 = toRGB565(texels[low]);
+	if (color0 < color1) swap(color0, color1); //color0 > color1 selects the four colour mode
+
+	float palette[4][3];
+	fromRGB565(color0, palette[0]);
+	fromRGB565(color1, palette[1]);
+	for (int c = 0; c < 3; c++) {
+		palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+		palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+	}
+
+	uint32_t selectors = 0;
+	if (color0 != color1) {
+		for (int i = 0; i < 16; i++) {
+			int best = 0;
+			float bestDistance = 1e30f;
+			for (int p = 0; p < 4; p++) {
+				float dr = texels[i][0] - palette[p][0], dg = texels[i][1] - palette[p][1], db = texels[i][2] - palette[p][2];
+				float distance = dr * dr + dg * dg + db * db;
+				if (distance < bestDistance) { bestDistance = distance; best = p; }
+			}
+			selectors |= (uint32_t)best << (i * 2);
+		}
+	}
+
+	out[0] = color0 & 0xFF; out[1] = color0 >> 8;
+	out[2] = color1 & 0xFF; out[3] = color1 >> 8;
+	for (int i = 0; i < 4; i++) out[4 + i] = (selectors >> (i * 8)) & 0xFF;
+}
+
+/// <summary>
+/// Compresses a whole level to BC1, clamping blocks that hang over the edge
+/// </summary>
+/// <param name="image">RGBA8 level</param>
+/// <returns>BC1 blocks in row order</returns>
+vector<unsigned char> encodeBC1(const Image& image) {
+	int blocksX = (image.width + 3) / 4, blocksY = (image.height + 3) / 4;
+	vector<unsigned char> blocks((size_t)blocksX * blocksY * 8);
+
+	for (int by = 0; by < blocksY; by++) {
+		for (int bx = 0; bx < blocksX; bx++) {
+			float texels[16][3];
+			for (int i = 0; i < 16; i++) {
+				int x = min(bx * 4 + i % 4, image.width - 1), y = min(by * 4 + i / 4, image.height - 1);
+				for (int c = 0; c < 3; c++) texels[i][c] = image.pixels[((size_t)y * image.width + x) * 4 + c];
+			}
+			encodeBC1Block(texels, &blocks[((size_t)by * blocksX + bx) * 8]);
+		}
+	}
+	return blocks;
+}
+
+/// <summary>
+/// Cooks one image into <image>.ptex
+/// </summary>
+/// <param name="path">Source image</param>
+/// <param name="format">Output format</param>
+/// <param name="width">Width to resize to, 0 to keep the image size</param>
+/// <param name="height">Height to resize to, 0 to keep the image size</param>
+/// <returns>true on success</returns>
+bool cook(const string& path, uint32_t format, int width, int height) {
+	Image image;
+	int channels;
+	unsigned char* data = stbi_load(path.c_str(), &image.width, &image.height, &channels, 4);
+	if (!data) {
+		cerr << "Failed to load " << path << endl;
+		return false;
+	}
+	if (width > 0 && height > 0 && (width != image.width || height != image.height)) {
+		image.pixels.resize((size_t)width * height * 4);
+		resampleRGBA8(data, image.width, image.height, image.pixels.data(), width, height);
+		image.width = width;
+		image.height = height;
+	}
+	else {
+		image.pixels.assign(data, data + (size_t)image.width * image.height * 4);
+	}
+	stbi_image_free(data);
+
+	//Full chain down to 1x1
+	vector<Image> mips = { image };
+	while (mips.back().width > 1 || mips.back().height > 1) mips.push_back(downsample(mips.back()));
+
+	CookedTextureHeader header = {};
+	memcpy(header.magic, COOKED_TEXTURE_MAGIC, 4);
+	header.version = COOKED_TEXTURE_VERSION;
+	header.format = format;
+	header.width = image.width;
+	header.height = image.height;
+	header.levelCount = mips.size();
+	struct stat source;
+	if (stat(path.c_str(), &source) == 0) {
+		header.sourceTime = source.st_mtime;
+		header.sourceSize = source.st_size;
+	}
+	header.sourceHash = hashFile(path);
+
+	vector<CookedTextureLevel> levels(mips.size());
+	vector<vector<unsigned char>> payloads(mips.size());
+	uint64_t offset = sizeof(CookedTextureHeader) + sizeof(CookedTextureLevel) * levels.size();
+	for (size_t i = 0; i < mips.size(); i++) {
+		payloads[i] = format == COOKED_BC1 ? encodeBC1(mips[i]) : mips[i].pixels;
+		offset = (offset + COOKED_TEXTURE_ALIGNMENT - 1) / COOKED_TEXTURE_ALIGNMENT * COOKED_TEXTURE_ALIGNMENT;
+		levels[i] = { (uint32_t)mips[i].width, (uint32_t)mips[i].height, offset, payloads[i].size() };
+		offset += payloads[i].size();
+	}
+
+	string outPath = path + ".ptex";
+	ofstream out(outPath, ios::binary | ios::trunc);
+	out.write((const char*)&header, sizeof(header));
+	out.write((const char*)levels.data(), sizeof(CookedTextureLevel) * levels.size());
+	for (size_t i = 0; i < payloads.size(); i++) {
+		static const char padding[COOKED_TEXTURE_ALIGNMENT] = {};
+		out.write(padding, levels[i].offset - (uint64_t)out.tellp());
+		out.write((const char*)payloads[i].data(), payloads[i].size());
+	}
+	if (!out) {
+		cerr << "Failed to write " << outPath << endl;
+		return false;
+	}
+
+	cout << path << ": " << image.width << "x" << image.height << ", " << mips.size() << " levels, "
+		<< (format == COOKED_BC1 ? "BC1" : "RGBA8") << ", " << offset << " bytes" << endl;
+	return true;
+}
+
+int main(int argc, char** argv) {
+	uint32_t format = COOKED_BC1;
+	int width = 0, height = 0;
+	int failures = 0, images = 0;
+
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--rgba8") format = COOKED_RGBA8;
+		else if (arg == "--bc1") format = COOKED_BC1;
+		else if (arg == "--size" && i + 1 < argc) {
+			string size = argv[++i];
+			size_t separator = size.find('x');
+			width = atoi(size.substr(0, separator).c_str());
+			height = separator == string::npos ? width : atoi(size.substr(separator + 1).c_str());
+		}
+		else {
+			images++;
+			if (!cook(arg, format, width, height)) failures++;
+		}
+	}
+
+	if (images == 0) {
+		cerr << "Usage: TextureCooker [--rgba8|--bc1] [--size <width>x<height>] <image>..." << endl;
+		return EXIT_FAILURE;
+	}
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,163 @@
+//Offline check of the packed vertex layout: packs the game's meshes the way uploadModel does, decodes them the way the
+//vertex shader does, and compares the result with the float vertices. Fails when a mesh would fall back to float
+//vertices or when any vertex moves past the bounds below, so a change to the packing can be checked without a GPU.
+//Usage: VertexPackCheck [--texture-size <pixels>] <repository root>
+//The texture size should match the game's TEXTURE_LAYER_SIZE.
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <set>
+#include <cstdlib>
+#include <cmath>
+
+#include <glad/glad.h>
+#include "levelMesh.h"
+
+using namespace std;
+
+//The check always reads loose files, Asset lookups just miss
+AssetPack assets;
+
+const float POSITION_STEPS = 1.0f; // Largest position error allowed per axis, in snorm16 steps of the mesh's half extent
+const float NORMAL_DEGREES = 0.05f; // Largest angle allowed between a normal and its decoded octahedral form
+const float TEXCOORD_TEXELS = 0.5f; // Largest texture coordinate error allowed, in texels of the texture size
+
+//Largest errors found in one mesh
+struct PackErrors
+{
+	float position = 0.0f;    //Worst axis error over the allowed one, 1 is right at the bound
+	float normalDegrees = 0.0f;
+	float texCoordTexels = 0.0f;
+};
+
+/// <summary>
+/// Reads the wall layout of a level file, the same way the game does
+/// </summary>
+/// <param name="path">Level file</param>
+/// <param name="grid">Grid to fill</param>
+/// <returns>true on success</returns>
+bool readLevelGrid(const string& path, LevelGrid& grid) {
+	ifstream lvlFile(path);
+	string size;
+	if (!(lvlFile >> size)) return false;
+	size_t separator = size.find('x');
+	if (separator == string::npos) return false;
+	int xMax = atoi(size.substr(0, separator).c_str());
+	int yMax = atoi(size.substr(separator + 1).c_str());
+
+	//Rows of the file run along x in world space
+	grid = LevelGrid(yMax, xMax);
+	for (int i = 0; i < yMax; i++) {
+		for (int j = 0; j < xMax; j++) {
+			int data;
+			if (!(lvlFile >> data)) return false;
+			if (data == 1) grid.setWall(i, j, true);
+		}
+	}
+	return true;
+}
+
+/// <summary>
+/// Packs a mesh and measures how far every decoded vertex ends up from its float source
+/// </summary>
+/// <param name="vertices">Float vertices</param>
+/// <param name="textureSize">Size of the textures sampled</param>
+/// <returns>Largest errors of the mesh</returns>
+PackErrors measurePacking(const vector<Vertex>& vertices, int textureSize) {
+	vector<PackedVertex> packed;
+	glm::mat4 decode = packVertices(vertices.data(), vertices.size(), packed);
+	glm::vec3 step = glm::vec3(decode[0][0], decode[1][1], decode[2][2]) / 32767.0f; //Half extent over the snorm16 range
+
+	PackErrors errors;
+	for (size_t i = 0; i < vertices.size(); i++) {
+		const PackedVertex& vertex = packed[i];
+
+		//Same decode as 7.1.camera.vs: snorm16 position through the decode matrix, octahedral normal, half float texture coordinates
+		glm::vec3 location(0.0f);
+		for (int axis = 0; axis < 3; axis++) {
+			location[axis] = glm::unpackSnorm1x16((uint16_t)vertex.location[axis]);
+		}
+		location = glm::vec3(decode * glm::vec4(location, 1.0f));
+		glm::vec3 normal = octahedralDecode(glm::vec2(glm::unpackSnorm1x16((uint16_t)vertex.normal[0]), glm::unpackSnorm1x16((uint16_t)vertex.normal[1])));
+		glm::vec2 texCoords(glm::unpackHalf1x16(vertex.texCoords[0]), glm::unpackHalf1x16(vertex.texCoords[1]));
+
+		for (int axis = 0; axis < 3; axis++) {
+			float error = glm::abs(location[axis] - vertices[i].location[axis]) / (step[axis] * POSITION_STEPS);
+			errors.position = max(errors.position, error);
+		}
+		float cosine = glm::clamp(glm::dot(normal, glm::normalize(vertices[i].normals)), -1.0f, 1.0f);
+		errors.normalDegrees = max(errors.normalDegrees, glm::degrees(acos(cosine)));
+		glm::vec2 texCoordError = glm::abs(texCoords - vertices[i].texCoords) * (float)textureSize;
+		errors.texCoordTexels = max(errors.texCoordTexels, max(texCoordError.x, texCoordError.y));
+	}
+	return errors;
+}
+
+/// <summary>
+/// Checks one mesh against the bounds and reports it
+/// </summary>
+/// <param name="name">Mesh name for the report</param>
+/// <param name="vertices">Float vertices</param>
+/// <param name="textureSize">Size of the textures sampled</param>
+/// <returns>true if the mesh packs within the bounds</returns>
+bool checkMesh(const string& name, const vector<Vertex>& vertices, int textureSize) {
+	if (vertices.empty()) {
+		cerr << name << ": no vertices" << endl;
+		return false;
+	}
+	if (!texCoordsPackable(vertices.data(), vertices.size(), textureSize)) {
+		cerr << name << ": texture coordinates do not survive half floats, the mesh would stay on float vertices" << endl;
+		return false;
+	}
+
+	PackErrors errors = measurePacking(vertices, textureSize);
+	bool passed = errors.position <= 1.0f && errors.normalDegrees <= NORMAL_DEGREES && errors.texCoordTexels <= TEXCOORD_TEXELS;
+	cout << name << ": " << vertices.size() << " vertices, position " << errors.position * POSITION_STEPS << " steps (max " << POSITION_STEPS
+		<< "), normal " << errors.normalDegrees << " degrees (max " << NORMAL_DEGREES << "), texture coordinates "
+		<< errors.texCoordTexels << " texels (max " << TEXCOORD_TEXELS << ")" << (passed ? "" : " FAILED") << endl;
+	return passed;
+}
+
+int main(int argc, char** argv) {
+	int textureSize = 1024;
+	string root;
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--texture-size" && i + 1 < argc) textureSize = max(1, atoi(argv[++i]));
+		else root = arg;
+	}
+	if (root.empty()) {
+		cerr << "Usage: VertexPackCheck [--texture-size <pixels>] <repository root>" << endl;
+		return EXIT_FAILURE;
+	}
+	if (root.back() != '/') root += '/';
+
+	int failures = 0;
+	const string models[2][2] = {
+		{ "resources/model/ghost/", "pacman-ghosts.obj" },
+		{ "resources/model/pellets/", "globe-sphere.obj" } };
+	for (auto& model : models) {
+		vector<Vertex> vertices;
+		vector<GLuint> indices;
+		parseModel(root + model[0], model[1], vertices, indices);
+		if (!checkMesh(model[1], vertices, textureSize)) failures++;
+	}
+
+	//Walls as the game builds them, greedy runs and single faces
+	string levelPath = root + "levels/level0";
+	LevelGrid grid;
+	if (!readLevelGrid(levelPath, grid)) {
+		cerr << "Failed to read " << levelPath << endl;
+		return EXIT_FAILURE;
+	}
+	for (bool greedy : { true, false }) {
+		vector<Vertex> vertices;
+		vector<GLuint> indices;
+		generateWallMesh(grid, greedy, 0, 0, grid.getSizeX(), grid.getSizeZ(), vertices, indices);
+		if (!checkMesh(greedy ? "level0 greedy walls" : "level0 walls", vertices, textureSize)) failures++;
+	}
+
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
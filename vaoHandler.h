@@ -5,32 +5,195 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tinyobjloader/tiny_obj_loader.h"
 #include <GLFW/glfw3.h>
+#include <unordered_map>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <fstream>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "mappedFile.h"
+#include "assetPack.h"
+#include "vertex.h"
+#include "meshSimplify.h"
 
 using namespace std;
 
-GLuint loadModel(const string path, const string file, int& size);
-void cleanVAO(GLuint& vao);
-GLuint wallSegment();
+//Header of a cooked mesh file, followed by vertexCount Vertex structs, indexCount GLuint indices and lodCount MeshLod ranges.
+//The source fields tell when the OBJ it was cooked from has changed.
+struct CookedMeshHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t sourceHash;
+	int64_t sourceTime;
+	uint64_t sourceSize;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t requestedLods; //Levels asked for when cooking, simplification may stop earlier
+	uint32_t lodCount;
+};
+
+const char COOKED_MESH_MAGIC[4] = { 'P', 'M', 'S', 'H' };
+const uint32_t COOKED_MESH_VERSION = 2; //Bump whenever Vertex or the header changes
+
+//Per-instance data read by the vertex shader, one entry per drawn element
+struct Instance
+{
+	glm::mat4 model;
+	float layer; //Texture array layer
+};
 
-//Data structure used in the following function
-struct Vertex
+//One draw of a glMultiDrawElementsIndirect call, laid out as OpenGL reads it from the indirect buffer
+struct DrawElementsIndirectCommand
 {
-	glm::vec3 location;
-	glm::vec3 normals;
-	glm::vec2 texCoords;
+	GLuint count;         //Indices to draw
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;  //First instance, offsets the per-instance attributes
 };
 
+//Non-owning view of a contiguous range of positions, so callers never copy their vectors
+struct PositionView
+{
+	const glm::vec3* data;
+	size_t size;
+
+	PositionView(const vector<glm::vec3>& positions) : data(positions.data()), size(positions.size()) {}
+	PositionView(const glm::vec3* _data, size_t _size) : data(_data), size(_size) {}
+	const glm::vec3* begin() const { return data; }
+	const glm::vec3* end() const { return data + size; }
+	const glm::vec3& operator[](size_t i) const { return data[i]; }
+};
+
+//Reads the .mtl files an OBJ refers to through Asset, so they come from the asset pack like the OBJ itself
+class AssetMaterialReader : public tinyobj::MaterialReader
+{
+public:
+	AssetMaterialReader(const string& _path) : path(_path) {}
+
+	bool operator()(const string& matId, vector<tinyobj::material_t>* materials, map<string, int>* matMap, string* warn, string* err) override {
+		Asset material(path + matId);
+		if (!material.isOpen()) {
+			if (warn) *warn += "Material file [ " + matId + " ] not found in " + path + "\n";
+			return false;
+		}
+		AssetStreamBuffer materialBuffer(material);
+		istream materialStream(&materialBuffer);
+		tinyobj::LoadMtl(matMap, materials, &materialStream, warn, err);
+		return true;
+	}
+
+private:
+	string path; //Directory of the OBJ, material names are relative to it
+};
+
+//Instance VBO attached to a VAO, with the number of instances in it
+struct InstanceBuffer
+{
+	GLuint VBO;
+	int count;
+	float scale;
+	float layer;
+	glm::mat4 meshTransform; //Position decode of the mesh, applied before each instance's transform
+};
+
+GLuint loadModel(const string path, const string file, int& size, MeshEncoding& encoding);
+GLuint loadModel(const string path, const string file, vector<MeshLod>& lods, int lodCount, MeshEncoding& encoding);
+void parseModel(const string& path, const string& file, vector<Vertex>& vertices, vector<GLuint>& indices);
+GLuint uploadModel(const Vertex* vertices, size_t vertexCount, const GLuint* indices, size_t indexCount, MeshEncoding& encoding);
+const CookedMeshHeader* cookedMeshHeader(const Asset& cooked, const string& sourcePath);
+void writeCookedMesh(const string& cookedPath, const string& sourcePath, const vector<Vertex>& vertices, const vector<GLuint>& indices, const vector<MeshLod>& lods, int requestedLods);
+void cleanVAO(GLuint& vao);
+InstanceBuffer createInstanceBuffer(GLuint VAO, PositionView positions, float scale, int layer, const glm::mat4& meshTransform);
+void attachInstanceBuffer(GLuint VAO, GLuint VBO);
+void updateInstance(InstanceBuffer& buffer, int index, glm::vec3 position);
+void updateInstances(InstanceBuffer& buffer, int first, PositionView positions);
+void copyInstance(InstanceBuffer& buffer, int from, int to);
+GLuint createIndirectBuffer(size_t commandCapacity);
+
 /// <summary>
-/// Loads 3D model from path
+/// Loads 3D model from path at full detail only
 /// </summary>
 /// <param name="path">Path to look</param>
 /// <param name="file">Which obj file to get</param>
-/// <param name="size">Size callback variable</param>
+/// <param name="size">Index count callback variable</param>
+/// <param name="encoding">Vertex layout to upload with, updated with the layout actually used and its position decode</param>
 /// <returns>Newly generated VAO for model</returns>
-GLuint loadModel(const std::string path, const std::string file, int& size)
+GLuint loadModel(const std::string path, const std::string file, int& size, MeshEncoding& encoding)
+{
+	vector<MeshLod> lods;
+	GLuint VAO = loadModel(path, file, lods, 1, encoding);
+	size = lods[0].indexCount;
+	return VAO;
+}
+
+/// <summary>
+/// Loads 3D model from path together with a chain of simplified levels of detail.
+/// Every level indexes the same vertices, and their index lists follow each other in one element buffer.
+/// A cooked binary copy of the mesh and its levels is kept next to the OBJ file. When it is up to date it is
+/// mapped into memory and uploaded as is, otherwise the OBJ is parsed, simplified and the cache is rewritten.
+/// </summary>
+/// <param name="path">Path to look</param>
+/// <param name="file">Which obj file to get</param>
+/// <param name="lods">Index range of every level, full detail first, filled by the function</param>
+/// <param name="lodCount">Number of levels to generate, each with half the triangles of the one before</param>
+/// <param name="encoding">Vertex layout to upload with, updated with the layout actually used and its position decode</param>
+/// <returns>Newly generated VAO for model</returns>
+GLuint loadModel(const std::string path, const std::string file, vector<MeshLod>& lods, int lodCount, MeshEncoding& encoding)
+{
+	auto start = chrono::steady_clock::now();
+	string sourcePath = path + file;
+	string cookedPath = sourcePath + ".mesh";
+	GLuint VAO = 0;
+	bool cached = false;
+
+	{
+		Asset cooked(cookedPath);
+		const CookedMeshHeader* header = cookedMeshHeader(cooked, sourcePath);
+		if (header && header->requestedLods == (uint32_t)lodCount) {
+			const Vertex* vertices = (const Vertex*)(cooked.data() + sizeof(CookedMeshHeader));
+			const GLuint* indices = (const GLuint*)(vertices + header->vertexCount);
+			const MeshLod* cookedLods = (const MeshLod*)(indices + header->indexCount);
+			VAO = uploadModel(vertices, header->vertexCount, indices, header->indexCount, encoding);
+			lods.assign(cookedLods, cookedLods + header->lodCount);
+			cached = true;
+		}
+	}
+
+	if (!cached) {
+		vector<Vertex> vertices;
+		vector<GLuint> indices;
+		parseModel(path, file, vertices, indices);
+		generateLods(vertices, indices, lodCount, lods);
+		writeCookedMesh(cookedPath, sourcePath, vertices, indices, lods, lodCount);
+		VAO = uploadModel(vertices.data(), vertices.size(), indices.data(), indices.size(), encoding);
+	}
+
+	double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	cout << file << (cached ? " loaded from cooked mesh" : " parsed from OBJ") << " in " << ms << " ms";
+	if (lods.size() > 1) {
+		cout << ", triangles per LOD:";
+		for (auto& lod : lods) cout << " " << lod.indexCount / 3;
+	}
+	cout << endl;
+	return VAO;
+}
+
+/// <summary>
+/// Parses an OBJ file into an indexed mesh
+/// </summary>
+/// <param name="path">Path to look</param>
+/// <param name="file">Which obj file to get</param>
+/// <param name="vertices">Unique vertices, filled by the function</param>
+/// <param name="indices">Triangle list indexing vertices, filled by the function</param>
+void parseModel(const string& path, const string& file, vector<Vertex>& vertices, vector<GLuint>& indices)
 {
 	//We create a vector of Vertex structs. OpenGL can understand these, and so will accept them as input.
-	vector<Vertex> vertices;
+	//Identical vertices are only stored once and referenced through the index list.
+	unordered_map<Vertex, GLuint, VertexHash> uniqueVertices;
 
 	//Some variables that we are going to use to store data from tinyObj
 	tinyobj::attrib_t attrib;
@@ -42,7 +205,16 @@ GLuint loadModel(const std::string path, const std::string file, int& size)
 	string err;
 
 	//We use tinobj to load our models. Feel free to find other .obj files and see if you can load them.
-	tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, (path + file).c_str(), (path).c_str());
+	//The OBJ and its materials are read in place from the asset pack or their mapped files.
+	Asset source(path + file);
+	if (!source.isOpen()) {
+		cerr << "Failed to open model " << path + file << std::endl;
+		return;
+	}
+	AssetStreamBuffer sourceBuffer(source);
+	istream sourceStream(&sourceBuffer);
+	AssetMaterialReader materialReader(path);
+	tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, &sourceStream, &materialReader);
 
 	if (!warn.empty()) {
 		cout << warn << std::endl;
@@ -53,10 +225,10 @@ GLuint loadModel(const std::string path, const std::string file, int& size)
 	}
 
 	//For each shape defined in the obj file
-	for (auto shape : shapes)
+	for (auto& shape : shapes)
 	{
 		//We find each mesh
-		for (auto meshIndex : shape.mesh.indices)
+		for (auto& meshIndex : shape.mesh.indices)
 		{
 			//And store the data for each vertice, including normals
 			glm::vec3 vertice = {
@@ -74,11 +246,31 @@ GLuint loadModel(const std::string path, const std::string file, int& size)
 				attrib.texcoords[(meshIndex.texcoord_index * 2) + 1]
 			};
 
-			vertices.push_back({ vertice, normal, textureCoordinate }); //We add our new vertice struct to our vector
-
+			Vertex vertex = { vertice, normal, textureCoordinate };
+			auto found = uniqueVertices.find(vertex);
+			if (found == uniqueVertices.end()) {
+				found = uniqueVertices.emplace(vertex, (GLuint)vertices.size()).first;
+				vertices.push_back(vertex); //We add our new vertice struct to our vector
+			}
+			indices.push_back(found->second);
 		}
 	}
+	cout << file << ": " << indices.size() << " vertices reduced to " << vertices.size() << " unique" << endl;
+}
 
+/// <summary>
+/// Creates a VAO from an indexed mesh.
+/// With VERTEX_PACKED the vertices are converted to PackedVertex and described with normalized and half float attributes,
+/// unless half floats would move a texture coordinate by more than half a texel, in which case the mesh stays VERTEX_FLOAT.
+/// </summary>
+/// <param name="vertices">Vertex data</param>
+/// <param name="vertexCount">Number of vertices</param>
+/// <param name="indices">Index data</param>
+/// <param name="indexCount">Number of indices</param>
+/// <param name="encoding">Vertex layout to upload with, updated with the layout actually used and its position decode</param>
+/// <returns>Newly generated VAO for model</returns>
+GLuint uploadModel(const Vertex* vertices, size_t vertexCount, const GLuint* indices, size_t indexCount, MeshEncoding& encoding)
+{
 	GLuint VAO;
 	glGenVertexArrays(1, &VAO);
 	glBindVertexArray(VAO);
@@ -87,22 +279,104 @@ GLuint loadModel(const std::string path, const std::string file, int& size)
 	glGenBuffers(1, &VBO);
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
 
-	//As you can see, OpenGL will accept a vector of structs as a valid input here
-	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertices.size(), &vertices[0], GL_STATIC_DRAW);
+	if (encoding.format == VERTEX_PACKED && !texCoordsPackable(vertices, vertexCount, encoding.textureSize)) {
+		cout << "Texture coordinates lose more than half a texel as half floats, keeping float vertices" << endl;
+		encoding.format = VERTEX_FLOAT;
+	}
 
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 8, nullptr);
+	if (encoding.format == VERTEX_PACKED) {
+		vector<PackedVertex> packed;
+		encoding.decode = packVertices(vertices, vertexCount, packed);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(PackedVertex) * vertexCount, packed.data(), GL_STATIC_DRAW);
+
+		// position attribute, snorm16 within the mesh bounds
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, location));
+		// texture coord attribute, half floats
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, texCoords));
+		// normal attribute, octahedral snorm16 decoded in the vertex shader
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, normal));
+	}
+	else {
+		//As you can see, OpenGL will accept a vector of structs as a valid input here
+		glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertexCount, vertices, GL_STATIC_DRAW);
+		encoding.decode = glm::mat4(1.0f);
+
+		// position attribute
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, location));
+		// texture coord attribute
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
+		// normal attribute
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normals));
+	}
 
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 8, (void*)(sizeof(float) * 3));
+	GLuint EBO;
+	glGenBuffers(1, &EBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indexCount, indices, GL_STATIC_DRAW);
 
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 8, (void*)(sizeof(float) * 6));
+	return VAO;
+}
 
-	//This will be needed later to specify how much we need to draw. Look at the main loop to find this variable again.
-	size = vertices.size();
+/// <summary>
+/// Checks a cooked mesh against the OBJ it was made from, see sourceUnchanged
+/// </summary>
+/// <param name="cooked">Cooked mesh file</param>
+/// <param name="sourcePath">OBJ file it was cooked from</param>
+/// <returns>Header of the cooked mesh, or nullptr if it is missing, corrupt or stale</returns>
+const CookedMeshHeader* cookedMeshHeader(const Asset& cooked, const string& sourcePath)
+{
+	if (!cooked.isOpen() || cooked.size() < sizeof(CookedMeshHeader)) return nullptr;
 
-	return VAO;
+	const CookedMeshHeader* header = (const CookedMeshHeader*)cooked.data();
+	if (memcmp(header->magic, COOKED_MESH_MAGIC, 4) != 0 || header->version != COOKED_MESH_VERSION) return nullptr;
+	size_t expected = sizeof(CookedMeshHeader) + sizeof(Vertex) * (size_t)header->vertexCount + sizeof(GLuint) * (size_t)header->indexCount
+		+ sizeof(MeshLod) * (size_t)header->lodCount;
+	if (cooked.size() != expected) return nullptr;
+
+	return sourceUnchanged(sourcePath, header->sourceSize, header->sourceTime, header->sourceHash) ? header : nullptr;
+}
+
+/// <summary>
+/// Writes a parsed mesh to a cooked mesh file
+/// </summary>
+/// <param name="cookedPath">File to write</param>
+/// <param name="sourcePath">OBJ file the mesh was parsed from</param>
+/// <param name="vertices">Mesh vertices</param>
+/// <param name="indices">Mesh indices of every level</param>
+/// <param name="lods">Index range of every level</param>
+/// <param name="requestedLods">Number of levels that was asked for</param>
+void writeCookedMesh(const string& cookedPath, const string& sourcePath, const vector<Vertex>& vertices, const vector<GLuint>& indices, const vector<MeshLod>& lods, int requestedLods)
+{
+	CookedMeshHeader header = {};
+	memcpy(header.magic, COOKED_MESH_MAGIC, 4);
+	header.version = COOKED_MESH_VERSION;
+	header.vertexCount = vertices.size();
+	header.indexCount = indices.size();
+	header.requestedLods = requestedLods;
+	header.lodCount = lods.size();
+
+	Asset source(sourcePath);
+	header.sourceSize = source.size();
+	header.sourceHash = source.hash();
+	struct stat sourceInfo;
+	if (!source.packed() && stat(sourcePath.c_str(), &sourceInfo) == 0) {
+		header.sourceTime = sourceInfo.st_mtime;
+	}
+
+	ofstream out(cookedPath, ios::binary | ios::trunc);
+	out.write((const char*)&header, sizeof(header));
+	out.write((const char*)vertices.data(), sizeof(Vertex) * vertices.size());
+	out.write((const char*)indices.data(), sizeof(GLuint) * indices.size());
+	out.write((const char*)lods.data(), sizeof(MeshLod) * lods.size());
+	if (!out) {
+		cout << "Failed to write cooked mesh " << cookedPath << endl;
+	}
 }
 
 /// <summary>
@@ -142,62 +416,126 @@ void cleanVAO(GLuint& vao)
 }
 
 /// <summary>
-/// VAO for wall segments of the map
+/// Builds the model matrix for one instance
 /// </summary>
-/// <returns>New VAO</returns>
-GLuint wallSegment() {
-	float vertices[] = {
-		-0.5f, -0.5f, -0.5f,  0.0f, 0.0f, 0.0f,  0.0f, -1.0f,
-		 0.5f, -0.5f, -0.5f,  1.0f, 0.0f, 0.0f,  0.0f, -1.0f,
-		 0.5f,  0.5f, -0.5f,  1.0f, 1.0f, 0.0f,  0.0f, -1.0f,
-		 0.5f,  0.5f, -0.5f,  1.0f, 1.0f, 0.0f,  0.0f, -1.0f,
-		-0.5f,  0.5f, -0.5f,  0.0f, 1.0f, 0.0f,  0.0f, -1.0f,
-		-0.5f, -0.5f, -0.5f,  0.0f, 0.0f, 0.0f,  0.0f, -1.0f,
-
-		-0.5f, -0.5f,  0.5f,  0.0f, 0.0f, 0.0f,  0.0f,  1.0f,
-		 0.5f, -0.5f,  0.5f,  1.0f, 0.0f, 0.0f,  0.0f,  1.0f,
-		 0.5f,  0.5f,  0.5f,  1.0f, 1.0f, 0.0f,  0.0f,  1.0f,
-		 0.5f,  0.5f,  0.5f,  1.0f, 1.0f, 0.0f,  0.0f,  1.0f,
-		-0.5f,  0.5f,  0.5f,  0.0f, 1.0f, 0.0f,  0.0f,  1.0f,
-		-0.5f, -0.5f,  0.5f,  0.0f, 0.0f, 0.0f,  0.0f,  1.0f,
-
-		-0.5f,  0.5f,  0.5f,  1.0f, 0.0f, -1.0f,  0.0f,  0.0f,
-		-0.5f,  0.5f, -0.5f,  1.0f, 1.0f, -1.0f,  0.0f,  0.0f,
-		-0.5f, -0.5f, -0.5f,  0.0f, 1.0f, -1.0f,  0.0f,  0.0f,
-		-0.5f, -0.5f, -0.5f,  0.0f, 1.0f, -1.0f,  0.0f,  0.0f,
-		-0.5f, -0.5f,  0.5f,  0.0f, 0.0f, -1.0f,  0.0f,  0.0f,
-		-0.5f,  0.5f,  0.5f,  1.0f, 0.0f, -1.0f,  0.0f,  0.0f,
-
-		 0.5f,  0.5f,  0.5f,  1.0f, 0.0f, 1.0f,  0.0f,  0.0f,
-		 0.5f,  0.5f, -0.5f,  1.0f, 1.0f, 1.0f,  0.0f,  0.0f,
-		 0.5f, -0.5f, -0.5f,  0.0f, 1.0f, 1.0f,  0.0f,  0.0f,
-		 0.5f, -0.5f, -0.5f,  0.0f, 1.0f, 1.0f,  0.0f,  0.0f,
-		 0.5f, -0.5f,  0.5f,  0.0f, 0.0f, 1.0f,  0.0f,  0.0f,
-		 0.5f,  0.5f,  0.5f,  1.0f, 0.0f, 1.0f,  0.0f,  0.0f,
-
-		 //Removed top and bottom faces as they will never be seen anyways
-	};
-
-	unsigned int VBO, VAO;
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
+/// <param name="position">Position of the instance</param>
+/// <param name="scale">Uniform scale of the instance</param>
+/// <param name="layer">Texture array layer of the instance</param>
+/// <param name="meshTransform">Position decode of the mesh</param>
+/// <returns>Instance data</returns>
+Instance makeInstance(glm::vec3 position, float scale, float layer, const glm::mat4& meshTransform) {
+	glm::mat4 model = glm::mat4(1.0f);
+	model = glm::translate(model, position);
+	model = glm::scale(model, glm::vec3(scale, scale, scale));
+	return { model * meshTransform, layer };
+}
 
-	glBindVertexArray(VAO);
+/// <summary>
+/// Creates an instance VBO for a VAO and fills it with one model matrix per position, see attachInstanceBuffer
+/// </summary>
+/// <param name="VAO">VAO to attach instance data to</param>
+/// <param name="positions">Initial instance positions</param>
+/// <param name="scale">Scale applied to every instance</param>
+/// <param name="layer">Texture array layer sampled by every instance</param>
+/// <param name="meshTransform">Position decode of the mesh, see MeshEncoding</param>
+/// <returns>New instance buffer</returns>
+InstanceBuffer createInstanceBuffer(GLuint VAO, PositionView positions, float scale, int layer, const glm::mat4& meshTransform) {
+	vector<Instance> instances;
+	instances.reserve(positions.size);
+	for (auto& position : positions) {
+		instances.push_back(makeInstance(position, scale, (float)layer, meshTransform));
+	}
 
+	InstanceBuffer buffer;
+	buffer.count = instances.size();
+	buffer.scale = scale;
+	buffer.layer = (float)layer;
+	buffer.meshTransform = meshTransform;
+
+	glGenBuffers(1, &buffer.VBO);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer.VBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(Instance) * instances.size(), instances.data(), GL_DYNAMIC_DRAW);
+	attachInstanceBuffer(VAO, buffer.VBO);
+
+	return buffer;
+}
+
+/// <summary>
+/// Makes a VAO read its instances from a buffer of Instance records.
+/// The matrix is bound to attribute locations 3-6 and the texture layer to location 7, all with a divisor of 1.
+/// </summary>
+/// <param name="VAO">VAO to attach instance data to</param>
+/// <param name="VBO">Instance buffer</param>
+void attachInstanceBuffer(GLuint VAO, GLuint VBO) {
+	glBindVertexArray(VAO);
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-	// position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	// texture coord attribute
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-	// normal attribute
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(5 * sizeof(float)));
-	glEnableVertexAttribArray(2);
 
-	return VAO;
+	//A mat4 attribute takes up four consecutive vec4 locations
+	for (int i = 0; i < 4; i++) {
+		glEnableVertexAttribArray(3 + i);
+		glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(sizeof(glm::vec4) * i));
+		glVertexAttribDivisor(3 + i, 1);
+	}
+	glEnableVertexAttribArray(7);
+	glVertexAttribPointer(7, 1, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)offsetof(Instance, layer));
+	glVertexAttribDivisor(7, 1);
+	glBindVertexArray(0);
+}
+
+/// <summary>
+/// Overwrites the model matrix of a single instance
+/// </summary>
+/// <param name="buffer">Instance buffer to update</param>
+/// <param name="index">Instance to update</param>
+/// <param name="position">New position of the instance</param>
+void updateInstance(InstanceBuffer& buffer, int index, glm::vec3 position) {
+	Instance instance = makeInstance(position, buffer.scale, buffer.layer, buffer.meshTransform);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer.VBO);
+	glBufferSubData(GL_ARRAY_BUFFER, sizeof(Instance) * index, sizeof(Instance), &instance);
+}
+
+/// <summary>
+/// Overwrites a range of instances in one upload, writing straight into the mapped buffer
+/// </summary>
+/// <param name="buffer">Instance buffer to update</param>
+/// <param name="first">First instance to update</param>
+/// <param name="positions">New positions, one per instance</param>
+void updateInstances(InstanceBuffer& buffer, int first, PositionView positions) {
+	if (positions.size == 0) return;
+
+	glBindBuffer(GL_ARRAY_BUFFER, buffer.VBO);
+	Instance* instances = (Instance*)glMapBufferRange(GL_ARRAY_BUFFER, sizeof(Instance) * first, sizeof(Instance) * positions.size,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+	if (instances == nullptr) return;
+	for (size_t i = 0; i < positions.size; i++) {
+		instances[i] = makeInstance(positions[i], buffer.scale, buffer.layer, buffer.meshTransform);
+	}
+	glUnmapBuffer(GL_ARRAY_BUFFER);
+}
+
+/// <summary>
+/// Copies one instance over another on the GPU, used to swap-and-pop an instance range the same way as its position vector
+/// </summary>
+/// <param name="buffer">Instance buffer to update</param>
+/// <param name="from">Instance to copy</param>
+/// <param name="to">Instance to overwrite</param>
+void copyInstance(InstanceBuffer& buffer, int from, int to) {
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer.VBO);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer.VBO);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, sizeof(Instance) * from, sizeof(Instance) * to, sizeof(Instance));
+}
+
+/// <summary>
+/// Creates a buffer for draw commands that are rewritten every frame
+/// </summary>
+/// <param name="commandCapacity">Most commands written in one frame</param>
+/// <returns>New GL_DRAW_INDIRECT_BUFFER</returns>
+GLuint createIndirectBuffer(size_t commandCapacity) {
+	GLuint buffer;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * commandCapacity, nullptr, GL_STREAM_DRAW);
+	return buffer;
 }
 
 #endif
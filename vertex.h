@@ -0,0 +1,142 @@
+#ifndef vertex_header
+#define vertex_header
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "glm/glm/glm.hpp"
+#include "glm/glm/gtc/packing.hpp"
+#include "glm/glm/gtc/matrix_transform.hpp"
+#include "mappedFile.h"
+
+//Data structure used in the following function
+struct Vertex
+{
+	glm::vec3 location;
+	glm::vec3 normals;
+	glm::vec2 texCoords;
+
+	bool operator==(const Vertex& other) const {
+		return location == other.location && normals == other.normals && texCoords == other.texCoords;
+	}
+};
+
+//Hashes the raw bytes of a Vertex so identical vertices can be merged
+struct VertexHash
+{
+	size_t operator()(const Vertex& vertex) const {
+		return hashBytes(&vertex, sizeof(Vertex));
+	}
+};
+
+//Vertex layouts a mesh can be uploaded with
+enum VertexFormat {
+	VERTEX_FLOAT,  //Vertex, 32 bytes
+	VERTEX_PACKED  //PackedVertex, 16 bytes
+};
+
+//Compact vertex for upload. Positions are snorm16 within the mesh bounds, normals octahedral snorm16 and
+//texture coordinates half floats. The bounds are undone by the matrix returned from packVertices.
+struct PackedVertex
+{
+	int16_t location[4]; //xyz, w is padding to keep the stride at 16 bytes
+	int16_t normal[2];
+	uint16_t texCoords[2];
+};
+
+//Requested vertex layout of a mesh, and how its positions decode once uploaded
+struct MeshEncoding
+{
+	VertexFormat format = VERTEX_FLOAT; //Set by the caller, uploads fall back to VERTEX_FLOAT where packing would lose precision
+	glm::mat4 decode = glm::mat4(1.0f); //Applied before the model matrix
+	int textureSize = 1024; //Size of the textures sampled, packed texture coordinates have to stay within half a texel of it
+};
+
+/// <summary>
+/// Folds a unit vector onto the octahedron and unfolds that onto a square, so it fits in two components
+/// </summary>
+/// <param name="normal">Unit vector</param>
+/// <returns>Octahedral coordinates in [-1, 1]</returns>
+inline glm::vec2 octahedralEncode(glm::vec3 normal) {
+	normal /= glm::abs(normal.x) + glm::abs(normal.y) + glm::abs(normal.z);
+	glm::vec2 encoded(normal.x, normal.y);
+	if (normal.z < 0) {
+		glm::vec2 sign(encoded.x >= 0 ? 1.0f : -1.0f, encoded.y >= 0 ? 1.0f : -1.0f);
+		encoded = (1.0f - glm::abs(glm::vec2(encoded.y, encoded.x))) * sign;
+	}
+	return encoded;
+}
+
+/// <summary>
+/// Inverse of octahedralEncode, the same decode the vertex shader does for packed vertices
+/// </summary>
+/// <param name="encoded">Octahedral coordinates</param>
+/// <returns>Unit vector</returns>
+inline glm::vec3 octahedralDecode(glm::vec2 encoded) {
+	glm::vec3 normal(encoded.x, encoded.y, 1.0f - glm::abs(encoded.x) - glm::abs(encoded.y));
+	if (normal.z < 0) {
+		glm::vec2 sign(normal.x >= 0 ? 1.0f : -1.0f, normal.y >= 0 ? 1.0f : -1.0f);
+		glm::vec2 folded = (1.0f - glm::abs(glm::vec2(normal.y, normal.x))) * sign;
+		normal.x = folded.x;
+		normal.y = folded.y;
+	}
+	return glm::normalize(normal);
+}
+
+/// <summary>
+/// Checks if the texture coordinates of a mesh survive the conversion to half floats.
+/// Each one is round-tripped, so whole number coordinates like those of greedy wall runs pass at any size half floats hold exactly.
+/// </summary>
+/// <param name="vertices">Float vertices</param>
+/// <param name="count">Number of vertices</param>
+/// <param name="textureSize">Size of the textures sampled</param>
+/// <returns>true if every coordinate comes back within half a texel</returns>
+inline bool texCoordsPackable(const Vertex* vertices, size_t count, int textureSize) {
+	float tolerance = 0.5f / textureSize;
+	for (size_t i = 0; i < count; i++) {
+		for (int axis = 0; axis < 2; axis++) {
+			float texCoord = vertices[i].texCoords[axis];
+			if (glm::abs(glm::unpackHalf1x16(glm::packHalf1x16(texCoord)) - texCoord) > tolerance) return false;
+		}
+	}
+	return true;
+}
+
+/// <summary>
+/// Converts vertices to the packed layout
+/// </summary>
+/// <param name="vertices">Float vertices</param>
+/// <param name="count">Number of vertices</param>
+/// <param name="packed">Packed vertices, filled by the function</param>
+/// <returns>Matrix taking packed positions back to model space, to be applied before the model matrix</returns>
+inline glm::mat4 packVertices(const Vertex* vertices, size_t count, std::vector<PackedVertex>& packed) {
+	glm::vec3 lower(0.0f), upper(0.0f);
+	for (size_t i = 0; i < count; i++) {
+		lower = i == 0 ? vertices[i].location : glm::min(lower, vertices[i].location);
+		upper = i == 0 ? vertices[i].location : glm::max(upper, vertices[i].location);
+	}
+	glm::vec3 center = (lower + upper) * 0.5f;
+	glm::vec3 extent = (upper - lower) * 0.5f;
+	for (int axis = 0; axis < 3; axis++) {
+		if (extent[axis] <= 0.0f) extent[axis] = 1.0f; //Flat along this axis
+	}
+
+	packed.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		glm::vec3 location = (vertices[i].location - center) / extent;
+		glm::vec2 normal = octahedralEncode(vertices[i].normals);
+		PackedVertex& vertex = packed[i];
+		for (int axis = 0; axis < 3; axis++) {
+			vertex.location[axis] = (int16_t)glm::packSnorm1x16(location[axis]);
+		}
+		vertex.location[3] = 0;
+		vertex.normal[0] = (int16_t)glm::packSnorm1x16(normal.x);
+		vertex.normal[1] = (int16_t)glm::packSnorm1x16(normal.y);
+		vertex.texCoords[0] = glm::packHalf1x16(vertices[i].texCoords.x);
+		vertex.texCoords[1] = glm::packHalf1x16(vertices[i].texCoords.y);
+	}
+
+	return glm::scale(glm::translate(glm::mat4(1.0f), center), extent);
+}
+
+#endif